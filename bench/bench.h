@@ -0,0 +1,80 @@
+// Minimal benchmark harness for transcript_bench.
+// Cases register themselves with BENCH_CASE and are selected by substring on the command line.
+#pragma once
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Bench {
+    struct Options {
+        std::string filter;
+        std::string opuspkt;        // recording to build packets from instead of synthetic audio
+        std::string capture;        // transcript.StartCapture file, used as the packet corpus or replayed with --replay
+        bool replay = false;
+        bool realtime = false;      // replay at the captured pace instead of as fast as possible
+        int effect = 1;             // AudioEffects effect applied during replay, EFF_BITCRUSH by default
+        double minTimeMs = 300;
+    };
+
+    typedef void (*CaseFn)(const Options& opts);
+
+    struct Case {
+        const char* name;
+        CaseFn fn;
+    };
+
+    std::vector<Case>& Registry();
+
+    // Feeds opts.capture through decode, effect and encode per player slot and prints per-stage times
+    int Replay(const Options& opts);
+
+    struct Registrar {
+        Registrar(const char* name, CaseFn fn) { Registry().push_back(Case{name, fn}); }
+    };
+
+    // operator new calls so far in this process, counted by bench/alloc_counter.cpp
+    uint64_t Allocations();
+
+    // Keeps the optimizer from dropping a result
+    template <typename T>
+    inline void DoNotOptimize(const T& value) {
+        static const void* volatile sink;
+        sink = &value;
+        (void)sink;
+    }
+
+    // Calls fn until minTimeMs has passed and prints the time per call, per item if items > 0, and heap allocations per call
+    template <typename F>
+    void Run(const Options& opts, const char* label, F&& fn, int itemsPerCall = 0, const char* itemName = "item") {
+        using Clock = std::chrono::steady_clock;
+        for (int i = 0; i < 3; i++) fn(); // warm up
+
+        uint64_t calls = 0;
+        uint64_t allocs = Allocations();
+        Clock::time_point start = Clock::now();
+        Clock::time_point now;
+        double elapsedMs;
+        do {
+            for (int i = 0; i < 16; i++) fn();
+            calls += 16;
+            now = Clock::now();
+            elapsedMs = std::chrono::duration<double, std::milli>(now - start).count();
+        } while (elapsedMs < opts.minTimeMs);
+
+        double allocsPerCall = (double)(Allocations() - allocs) / (double)calls;
+
+        double nsPerCall = elapsedMs * 1e6 / (double)calls;
+        if (itemsPerCall > 0) {
+            printf("  %-40s %12.1f ns/call %10.2f ns/%s %8.2f allocs/call  (%llu calls)\n", label, nsPerCall, nsPerCall / itemsPerCall, itemName, allocsPerCall, (unsigned long long)calls);
+        } else {
+            printf("  %-40s %12.1f ns/call %8.2f allocs/call  (%llu calls)\n", label, nsPerCall, allocsPerCall, (unsigned long long)calls);
+        }
+    }
+}
+
+#define BENCH_CASE(name) \
+    static void name(const Bench::Options& opts); \
+    static Bench::Registrar name##_registrar(#name, name); \
+    static void name(const Bench::Options& opts)
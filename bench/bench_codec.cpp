@@ -0,0 +1,286 @@
+// Decode, effect and encode stages of the voice path, the same calls the hook makes per packet.
+#include "bench.h"
+#include "voice_corpus.h"
+#include "steam_voice.h"
+#include "opus_framedecoder.h"
+#include "audio_effects.h"
+#include "sample_convert.h"
+#include "resampler.h"
+#include "codec_pool.h"
+#include <cstring>
+#include <cstdio>
+
+#define BENCH_PCM_SZ (20 * 1024)
+
+BENCH_CASE(codec_decompress) {
+    std::vector<VoiceCorpus::Packet> packets = VoiceCorpus::ForOptions(opts);
+    SteamOpus::Opus_FrameDecoder codec;
+    std::vector<char> pcm(BENCH_PCM_SZ);
+    size_t i = 0;
+
+    Bench::Run(opts, "DecompressIntoBuffer", [&]() {
+        const VoiceCorpus::Packet& p = packets[i++ % packets.size()];
+        int n = SteamVoice::DecompressIntoBuffer(&codec, p.data(), (int)p.size(), pcm.data(), (int)pcm.size());
+        Bench::DoNotOptimize(n);
+    }, 1, "packet");
+}
+
+BENCH_CASE(codec_effects) {
+    std::vector<int16_t> source = VoiceCorpus::SyntheticPCM(2 * FRAME_SIZE_GMOD);
+    std::vector<int16_t> pcm(source.size());
+
+    AudioEffects::EffectParams params;
+    const int effects[] = { AudioEffects::EFF_BITCRUSH, AudioEffects::EFF_DESAMPLE };
+    const char* names[] = { "EFF_BITCRUSH (960 samples)", "EFF_DESAMPLE (960 samples)" };
+    for (int e = 0; e < 2; e++) {
+        params.effect = effects[e];
+        Bench::Run(opts, names[e], [&]() {
+            memcpy(pcm.data(), source.data(), source.size() * sizeof(int16_t));
+            int samples = (int)pcm.size();
+            AudioEffects::Apply(pcm.data(), samples, params);
+            Bench::DoNotOptimize(samples);
+        }, (int)source.size(), "sample");
+    }
+}
+
+BENCH_CASE(codec_compress) {
+    std::vector<int16_t> pcm = VoiceCorpus::SyntheticPCM(250 * 2 * FRAME_SIZE_GMOD);
+    SteamOpus::Opus_FrameDecoder codec;
+    std::vector<char> out(BENCH_PCM_SZ);
+    const int chunk = 2 * FRAME_SIZE_GMOD;
+    size_t i = 0;
+
+    Bench::Run(opts, "CompressIntoBuffer (2 frames)", [&]() {
+        const int16_t* src = pcm.data() + (i++ % 250) * chunk;
+        int n = SteamVoice::CompressIntoBuffer(0, &codec, (const char*)src, chunk * 2, out.data(), (int)out.size(), SAMPLERATE_GMOD_OPUS);
+        Bench::DoNotOptimize(n);
+    }, 1, "packet");
+
+    // Chunks that aren't a whole number of frames, so every call carries samples over to the next
+    const int oddChunk = 700;
+    size_t offset = 0;
+    Bench::Run(opts, "Compress (700 samples, carry over)", [&]() {
+        if (offset + oddChunk > pcm.size()) offset = 0;
+        int n = codec.Compress((const char*)(pcm.data() + offset), oddChunk, out.data(), (int)out.size(), false);
+        offset += oddChunk;
+        Bench::DoNotOptimize(n);
+    }, oddChunk, "sample");
+}
+
+// What the CPU governor trades away when it lowers the complexity cap
+BENCH_CASE(codec_complexity) {
+    std::vector<int16_t> pcm = VoiceCorpus::SyntheticPCM(250 * 2 * FRAME_SIZE_GMOD);
+    SteamOpus::Opus_FrameDecoder codec;
+    std::vector<char> out(BENCH_PCM_SZ);
+    const int chunk = 2 * FRAME_SIZE_GMOD;
+
+    for (int complexity : { 10, 8, 5, 2, 0 }) {
+        SteamOpus::EncoderProfile profile;
+        profile.complexity = (int8_t)complexity;
+        codec.SetEncoderProfile(profile);
+
+        char label[64];
+        snprintf(label, sizeof(label), "CompressIntoBuffer (complexity %d)", complexity);
+        size_t i = 0;
+        Bench::Run(opts, label, [&]() {
+            const int16_t* src = pcm.data() + (i++ % 250) * chunk;
+            int n = SteamVoice::CompressIntoBuffer(0, &codec, (const char*)src, chunk * 2, out.data(), (int)out.size(), SAMPLERATE_GMOD_OPUS);
+            Bench::DoNotOptimize(n);
+        }, 1, "packet");
+    }
+}
+
+// One frame per packet with every 10th packet lost, from a client encoding with in-band FEC
+BENCH_CASE(codec_loss) {
+    const int packets = 500;
+    std::vector<int16_t> pcm = VoiceCorpus::SyntheticPCM(packets * FRAME_SIZE_GMOD);
+    int err = 0;
+    OpusEncoder* enc = opus_encoder_create(SAMPLERATE_GMOD_OPUS, 1, OPUS_APPLICATION_VOIP, &err);
+    opus_encoder_ctl(enc, OPUS_SET_INBAND_FEC(1));
+    opus_encoder_ctl(enc, OPUS_SET_PACKET_LOSS_PERC(10));
+
+    std::vector<VoiceCorpus::Packet> stream;
+    std::vector<unsigned char> frame(OPUS_MAX_FRAME_BYTES);
+    for (int i = 0; i < packets; i++) {
+        int n = opus_encode(enc, pcm.data() + i * FRAME_SIZE_GMOD, FRAME_SIZE_GMOD, frame.data(), (opus_int32)frame.size());
+        if (i % 10 == 9 || n <= 0) continue;
+        stream.push_back(VoiceCorpus::BuildPacket(0, { std::vector<unsigned char>(frame.begin(), frame.begin() + n) }, (uint16_t)i));
+    }
+    opus_encoder_destroy(enc);
+
+    std::vector<char> out(BENCH_PCM_SZ);
+    for (int cap : { 10, 0 }) {
+        SteamOpus::Opus_FrameDecoder codec;
+        SteamOpus::Loss::SetMaxConcealFrames(cap);
+        SteamOpus::Loss::Reset();
+        size_t i = 0;
+
+        Bench::Run(opts, cap ? "DecompressIntoBuffer (10% loss)" : "DecompressIntoBuffer (10% loss, no PLC)", [&]() {
+            // Start over at the end so the sequence numbers keep going up
+            if (i == stream.size()) {
+                i = 0;
+                codec.ResetState();
+                SteamVoice::DecompressIntoBuffer(&codec, stream[i].data(), (int)stream[i].size(), out.data(), (int)out.size());
+                i++;
+            }
+            const VoiceCorpus::Packet& p = stream[i++];
+            int n = SteamVoice::DecompressIntoBuffer(&codec, p.data(), (int)p.size(), out.data(), (int)out.size());
+            Bench::DoNotOptimize(n);
+        }, 1, "packet");
+
+        SteamOpus::Loss::Counters loss = SteamOpus::Loss::Get();
+        printf("  %-40s fec %llu, plc %llu, dropped %llu\n", "", (unsigned long long)loss.fec, (unsigned long long)loss.plc, (unsigned long long)loss.dropped);
+    }
+    SteamOpus::Loss::SetMaxConcealFrames(10);
+}
+
+// Every tenth frame arrives one packet late. Without a jitter buffer each swap costs a concealed frame and a late one.
+BENCH_CASE(codec_reorder) {
+    const int packets = 500;
+    std::vector<int16_t> pcm = VoiceCorpus::SyntheticPCM(packets * FRAME_SIZE_GMOD);
+    int err = 0;
+    OpusEncoder* enc = opus_encoder_create(SAMPLERATE_GMOD_OPUS, 1, OPUS_APPLICATION_VOIP, &err);
+
+    std::vector<VoiceCorpus::Packet> stream;
+    std::vector<unsigned char> frame(OPUS_MAX_FRAME_BYTES);
+    for (int i = 0; i < packets; i++) {
+        int n = opus_encode(enc, pcm.data() + i * FRAME_SIZE_GMOD, FRAME_SIZE_GMOD, frame.data(), (opus_int32)frame.size());
+        if (n <= 0) continue;
+        stream.push_back(VoiceCorpus::BuildPacket(0, { std::vector<unsigned char>(frame.begin(), frame.begin() + n) }, (uint16_t)i));
+        if (i % 10 == 9) std::swap(stream[stream.size() - 1], stream[stream.size() - 2]);
+    }
+    opus_encoder_destroy(enc);
+
+    std::vector<char> out(BENCH_PCM_SZ);
+    for (int depth : { 0, 2 }) {
+        SteamOpus::Opus_FrameDecoder codec;
+        SteamOpus::Loss::SetJitterDepth(depth);
+        SteamOpus::Loss::Reset();
+        size_t i = 0;
+
+        Bench::Run(opts, depth ? "DecompressIntoBuffer (10% reordered, depth 2)" : "DecompressIntoBuffer (10% reordered, depth 0)", [&]() {
+            if (i == stream.size()) {
+                i = 0;
+                codec.ResetState();
+            }
+            const VoiceCorpus::Packet& p = stream[i++];
+            int n = SteamVoice::DecompressIntoBuffer(&codec, p.data(), (int)p.size(), out.data(), (int)out.size());
+            Bench::DoNotOptimize(n);
+        }, 1, "packet");
+
+        SteamOpus::Loss::Counters loss = SteamOpus::Loss::Get();
+        printf("  %-40s plc %llu, late %llu\n", "", (unsigned long long)loss.plc, (unsigned long long)loss.late);
+    }
+    SteamOpus::Loss::SetJitterDepth(0);
+}
+
+BENCH_CASE(codec_transcode) {
+    std::vector<VoiceCorpus::Packet> packets = VoiceCorpus::ForOptions(opts);
+    SteamOpus::Opus_FrameDecoder codec;
+    std::vector<char> pcm(BENCH_PCM_SZ);
+    std::vector<char> out(BENCH_PCM_SZ);
+    AudioEffects::EffectParams params;
+    params.effect = AudioEffects::EFF_BITCRUSH;
+    size_t i = 0;
+    // Packets the module can copy back over the engine's buffer instead of sending from scratch
+    size_t encoded = 0, fit = 0;
+
+    Bench::Run(opts, "decompress + bitcrush + compress", [&]() {
+        const VoiceCorpus::Packet& p = packets[i++ % packets.size()];
+        int bytes = SteamVoice::DecompressIntoBuffer(&codec, p.data(), (int)p.size(), pcm.data(), (int)pcm.size());
+        if (bytes <= 0) return;
+        int samples = bytes / 2;
+        AudioEffects::Apply((int16_t*)pcm.data(), samples, params);
+        int n = SteamVoice::CompressIntoBuffer(0, &codec, pcm.data(), samples * 2, out.data(), (int)out.size(), SAMPLERATE_GMOD_OPUS);
+        if (n > 0) {
+            encoded++;
+            if (n <= (int)p.size()) fit++;
+        }
+        Bench::DoNotOptimize(n);
+    }, 1, "packet");
+    printf("  %-40s %zu of %zu packets fit back in place\n", "", fit, encoded);
+}
+
+// The same transcode as codec_transcode, decoded, crushed and encoded in float
+BENCH_CASE(codec_transcode_float) {
+    std::vector<VoiceCorpus::Packet> packets = VoiceCorpus::ForOptions(opts);
+    SteamOpus::Opus_FrameDecoder codec;
+    std::vector<float> pcm(BENCH_PCM_SZ / sizeof(int16_t));
+    std::vector<char> out(BENCH_PCM_SZ);
+    AudioEffects::EffectParams params;
+    params.effect = AudioEffects::EFF_BITCRUSH;
+    size_t i = 0;
+
+    Bench::Run(opts, "decompress + bitcrush + compress (float)", [&]() {
+        const VoiceCorpus::Packet& p = packets[i++ % packets.size()];
+        SteamVoice::DecodedVoice voice;
+        int samples = SteamVoice::DecodeSpans(&codec, p.data(), (int)p.size(), pcm.data(), (int)pcm.size(), voice);
+        if (samples <= 0) return;
+        AudioEffects::Apply(pcm.data(), samples, params);
+        voice = SteamVoice::DecodedVoice();
+        voice.Add(samples, false);
+        int n = SteamVoice::CompressSpans(0, &codec, voice, pcm.data(), out.data(), (int)out.size(), SAMPLERATE_GMOD_OPUS);
+        Bench::DoNotOptimize(n);
+    }, 1, "packet");
+}
+
+// What transcript.EnableEffect pays to give a player a codec and take it back again
+BENCH_CASE(codec_acquire) {
+    Bench::Run(opts, "new + delete Opus_FrameDecoder", [&]() {
+        SteamOpus::Opus_FrameDecoder* codec = new SteamOpus::Opus_FrameDecoder();
+        codec->Init(5, SAMPLERATE_GMOD_OPUS);
+        codec->Release();
+    });
+
+    SteamOpus::CodecPool pool;
+    Bench::Run(opts, "CodecPool Acquire + Release", [&]() {
+        SteamOpus::Opus_FrameDecoder* codec = pool.Acquire();
+        codec->Init(5, SAMPLERATE_GMOD_OPUS);
+        codec->Release();
+    });
+}
+
+// The int16 <-> float conversions at the edges of the float pipeline
+BENCH_CASE(sample_convert) {
+    std::vector<int16_t> pcm = VoiceCorpus::SyntheticPCM(2 * FRAME_SIZE_GMOD);
+    std::vector<float> f(pcm.size());
+    std::vector<int16_t> back(pcm.size());
+    const int n = (int)pcm.size();
+
+    Bench::Run(opts, "SampleConvert::ToFloat (960 samples)", [&]() {
+        SampleConvert::ToFloat(pcm.data(), f.data(), n);
+        Bench::DoNotOptimize(f[0]);
+    }, n, "sample");
+
+    Bench::Run(opts, "SampleConvert::ToInt16 (960 samples)", [&]() {
+        SampleConvert::ToInt16(f.data(), back.data(), n);
+        Bench::DoNotOptimize(back[0]);
+    }, n, "sample");
+
+    std::vector<float> crushed(f.size());
+    AudioEffects::EffectParams params;
+    params.effect = AudioEffects::EFF_BITCRUSH;
+    Bench::Run(opts, "EFF_BITCRUSH float (960 samples)", [&]() {
+        memcpy(crushed.data(), f.data(), f.size() * sizeof(float));
+        int samples = n;
+        AudioEffects::Apply(crushed.data(), samples, params);
+        Bench::DoNotOptimize(samples);
+    }, n, "sample");
+}
+
+// One packet of 24 kHz voice converted for the recorder, per input sample
+BENCH_CASE(resampler) {
+    std::vector<int16_t> pcm = VoiceCorpus::SyntheticPCM(2 * FRAME_SIZE_GMOD);
+    const int n = (int)pcm.size();
+    const int rates[] = { 16000, 48000 };
+    const char* names[] = { "Resampler 24k -> 16k (960 samples)", "Resampler 24k -> 48k (960 samples)" };
+    for (int r = 0; r < 2; r++) {
+        Resampler resampler;
+        resampler.Configure(SAMPLERATE_GMOD_OPUS, rates[r]);
+        std::vector<int16_t> out(resampler.MaxOutput(n));
+        Bench::Run(opts, names[r], [&]() {
+            int written = resampler.Process(pcm.data(), n, out.data(), (int)out.size());
+            Bench::DoNotOptimize(written);
+        }, n, "sample");
+    }
+}
@@ -0,0 +1,26 @@
+// CRC32 implementations on voice packet sized buffers. "bytewise" is the same algorithm as tier1's
+// CRC32_ProcessSingleBuffer, which transcript_core doesn't link.
+#include "bench.h"
+#include "crc32.h"
+
+BENCH_CASE(crc32) {
+    std::vector<unsigned char> buf(1500);
+    uint32_t x = 1;
+    for (auto& b : buf) {
+        x = x * 1664525u + 1013904223u;
+        b = (unsigned char)(x >> 24);
+    }
+
+    for (int len : { 64, 200, 1500 }) {
+        for (int impl = 0; impl < CRC32::IMPL_COUNT; impl++) {
+            if (!CRC32::Supported((CRC32::Impl)impl)) continue;
+
+            char label[64];
+            snprintf(label, sizeof(label), "%-10s %4d bytes", CRC32::ImplName((CRC32::Impl)impl), len);
+            Bench::Run(opts, label, [&]() {
+                CRC32::CRC32_t crc = CRC32::ProcessSingleBufferWith((CRC32::Impl)impl, buf.data(), len);
+                Bench::DoNotOptimize(crc);
+            }, len, "byte");
+        }
+    }
+}
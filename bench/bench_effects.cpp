@@ -0,0 +1,68 @@
+// The int16 effect kernels on one 480-sample frame, per implementation. Each SIMD path is checked
+// against the scalar one first, since the module switches between them by CPU alone.
+#include "bench.h"
+#include "voice_corpus.h"
+#include "audio_effects.h"
+#include <cstring>
+
+#define BENCH_EFFECT_FRAME 480
+
+// Samples that differ from the scalar output, for a buffer with the extremes and a frame of voice
+static int CompareWithScalar(AudioEffects::Impl impl, int effect) {
+    std::vector<int16_t> source = VoiceCorpus::SyntheticPCM(BENCH_EFFECT_FRAME + 13);
+    source[0] = -32768;
+    source[1] = 32767;
+    source[2] = -1;
+    source[3] = 0;
+
+    std::vector<int16_t> expect = source;
+    std::vector<int16_t> got = source;
+    const int samples = (int)source.size();
+    if (effect == AudioEffects::EFF_BITCRUSH) {
+        AudioEffects::BitCrushWith(AudioEffects::IMPL_SCALAR, expect.data(), samples, 350, 1.2f);
+        AudioEffects::BitCrushWith(impl, got.data(), samples, 350, 1.2f);
+    }
+    else {
+        // Every rate, each its own filter table
+        for (int rate = 2; rate <= DESAMPLE_MAX_RATE; rate++) {
+            AudioEffects::DesampleWith(AudioEffects::IMPL_SCALAR, expect.data(), samples, rate);
+            AudioEffects::DesampleWith(impl, got.data(), samples, rate);
+        }
+    }
+
+    int diff = 0;
+    for (int i = 0; i < samples; i++) {
+        if (got[i] != expect[i]) diff++;
+    }
+    return diff;
+}
+
+BENCH_CASE(effect_kernels) {
+    std::vector<int16_t> source = VoiceCorpus::SyntheticPCM(BENCH_EFFECT_FRAME);
+    std::vector<int16_t> pcm(source.size());
+    // Carried from frame to frame like a player's stream
+    AudioEffects::DesampleState state;
+
+    for (int effect : { AudioEffects::EFF_BITCRUSH, AudioEffects::EFF_DESAMPLE }) {
+        for (int impl = 0; impl < AudioEffects::IMPL_COUNT; impl++) {
+            if (!AudioEffects::Supported((AudioEffects::Impl)impl)) continue;
+
+            const char* effectName = effect == AudioEffects::EFF_BITCRUSH ? "BitCrush" : "Desample";
+            int diff = CompareWithScalar((AudioEffects::Impl)impl, effect);
+            if (diff != 0) {
+                printf("  %s %s differs from scalar in %d samples\n", effectName, AudioEffects::ImplName((AudioEffects::Impl)impl), diff);
+            }
+
+            char label[64];
+            snprintf(label, sizeof(label), "%s %-6s (%d samples)", effectName, AudioEffects::ImplName((AudioEffects::Impl)impl), BENCH_EFFECT_FRAME);
+            Bench::Run(opts, label, [&]() {
+                memcpy(pcm.data(), source.data(), source.size() * sizeof(int16_t));
+                if (effect == AudioEffects::EFF_BITCRUSH)
+                    AudioEffects::BitCrushWith((AudioEffects::Impl)impl, pcm.data(), (int)pcm.size(), 350, 1.2f);
+                else
+                    AudioEffects::DesampleWith((AudioEffects::Impl)impl, pcm.data(), (int)pcm.size(), 2, &state);
+                Bench::DoNotOptimize(pcm[0]);
+            }, BENCH_EFFECT_FRAME, "sample");
+        }
+    }
+}
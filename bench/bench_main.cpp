@@ -0,0 +1,71 @@
+#include "bench.h"
+#include <cstring>
+#include <cstdlib>
+#include "audio_effects.h"
+
+namespace Bench {
+    std::vector<Case>& Registry() {
+        static std::vector<Case> cases;
+        return cases;
+    }
+}
+
+static void Usage(const char* argv0) {
+    printf("usage: %s [--filter substring] [--opuspkt recording.opuspkt] [--capture capture.vcap] [--min-time ms] [--list]\n", argv0);
+    printf("       %s --capture capture.vcap --replay [--realtime] [--effect none|bitcrush|desample]\n", argv0);
+}
+
+int main(int argc, char** argv) {
+    Bench::Options opts;
+    bool list = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--filter") && i + 1 < argc) {
+            opts.filter = argv[++i];
+        } else if (!strcmp(argv[i], "--opuspkt") && i + 1 < argc) {
+            opts.opuspkt = argv[++i];
+        } else if (!strcmp(argv[i], "--capture") && i + 1 < argc) {
+            opts.capture = argv[++i];
+        } else if (!strcmp(argv[i], "--replay")) {
+            opts.replay = true;
+        } else if (!strcmp(argv[i], "--realtime")) {
+            opts.realtime = true;
+        } else if (!strcmp(argv[i], "--effect") && i + 1 < argc) {
+            const char* eff = argv[++i];
+            if (!strcmp(eff, "none")) opts.effect = AudioEffects::EFF_NONE;
+            else if (!strcmp(eff, "bitcrush")) opts.effect = AudioEffects::EFF_BITCRUSH;
+            else if (!strcmp(eff, "desample")) opts.effect = AudioEffects::EFF_DESAMPLE;
+            else { Usage(argv[0]); return 1; }
+        } else if (!strcmp(argv[i], "--min-time") && i + 1 < argc) {
+            opts.minTimeMs = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--list")) {
+            list = true;
+        } else {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (opts.replay) {
+        if (opts.capture.empty()) {
+            Usage(argv[0]);
+            return 1;
+        }
+        return Bench::Replay(opts);
+    }
+
+    for (const Bench::Case& c : Bench::Registry()) {
+        if (!opts.filter.empty() && !strstr(c.name, opts.filter.c_str()))
+            continue;
+
+        if (list) {
+            printf("%s\n", c.name);
+            continue;
+        }
+
+        printf("%s\n", c.name);
+        c.fn(opts);
+    }
+
+    return 0;
+}
@@ -0,0 +1,122 @@
+// Replays a transcript.StartCapture file through the same decode, effect and encode calls the hook makes.
+#include "bench.h"
+#include "voice_capture.h"
+#include "steam_voice.h"
+#include "opus_framedecoder.h"
+#include "audio_effects.h"
+#include "crc32.h"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+
+#define REPLAY_BUF_SZ (20 * 1024)
+
+namespace {
+    struct StageTimes {
+        const char* name;
+        std::vector<double> us;
+
+        explicit StageTimes(const char* n) : name(n) {}
+
+        void Print() {
+            if (us.empty()) return;
+            std::sort(us.begin(), us.end());
+            double total = 0;
+            for (double v : us) total += v;
+            printf("  %-12s %8zu calls  mean %8.1f us  p50 %8.1f us  p99 %8.1f us  max %8.1f us\n", name, us.size(),
+                total / us.size(), us[us.size() / 2], us[std::min(us.size() - 1, us.size() * 99 / 100)], us.back());
+        }
+    };
+
+    struct SlotState {
+        int userid = -1;
+        std::unique_ptr<SteamOpus::Opus_FrameDecoder> codec;
+    };
+
+    double Micros(std::chrono::steady_clock::duration d) {
+        return std::chrono::duration<double, std::micro>(d).count();
+    }
+}
+
+namespace Bench {
+    int Replay(const Options& opts) {
+        using Clock = std::chrono::steady_clock;
+
+        VoiceCaptureReader reader;
+        if (!reader.Open(opts.capture)) {
+            printf("could not read capture %s\n", opts.capture.c_str());
+            return 1;
+        }
+
+        AudioEffects::EffectParams params;
+        params.effect = opts.effect;
+
+        std::unordered_map<int, SlotState> slots;
+        std::vector<char> pcm(REPLAY_BUF_SZ);
+        std::vector<char> out(REPLAY_BUF_SZ);
+        StageTimes decode("decompress"), effect("effect"), encode("compress"), total("packet");
+        uint64_t packets = 0, skipped = 0, failed = 0;
+        uint64_t firstTs = 0, lastTs = 0;
+
+        CaptureRecord rec;
+        Clock::time_point start = Clock::now();
+        while (reader.Next(rec)) {
+            if (packets + skipped == 0) firstTs = rec.timestampNs;
+            lastTs = rec.timestampNs;
+            if (opts.realtime) {
+                std::this_thread::sleep_until(start + std::chrono::nanoseconds(rec.timestampNs - firstTs));
+            }
+
+            if (rec.data.size() <= sizeof(uint64_t) + sizeof(CRC32::CRC32_t)) {
+                skipped++;
+                continue;
+            }
+            packets++;
+
+            // Same as the hook: a slot handed to another userid starts over with a fresh codec
+            SlotState& slot = slots[rec.slot];
+            if (slot.userid != rec.userid || !slot.codec) {
+                slot.userid = rec.userid;
+                slot.codec.reset(new SteamOpus::Opus_FrameDecoder());
+                slot.codec->Init(5, SAMPLERATE_GMOD_OPUS);
+            }
+
+            Clock::time_point t0 = Clock::now();
+            int bytes = SteamVoice::DecompressIntoBuffer(slot.codec.get(), rec.data.data(), (int)rec.data.size(), pcm.data(), (int)pcm.size());
+            Clock::time_point t1 = Clock::now();
+            decode.us.push_back(Micros(t1 - t0));
+            if (bytes <= 0) {
+                failed++;
+                continue;
+            }
+
+            int samples = bytes / 2;
+            AudioEffects::Apply((int16_t*)pcm.data(), samples, params);
+            Clock::time_point t2 = Clock::now();
+            effect.us.push_back(Micros(t2 - t1));
+
+            uint64_t steamid;
+            memcpy(&steamid, rec.data.data(), sizeof(steamid));
+            int written = SteamVoice::CompressIntoBuffer(steamid, slot.codec.get(), pcm.data(), samples * 2, out.data(), (int)out.size(), SAMPLERATE_GMOD_OPUS);
+            Clock::time_point t3 = Clock::now();
+            encode.us.push_back(Micros(t3 - t2));
+            total.us.push_back(Micros(t3 - t0));
+            if (written <= 0) failed++;
+            DoNotOptimize(written);
+        }
+        double wallMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        double capturedMs = (lastTs - firstTs) / 1e6;
+
+        printf("replay %s\n", opts.capture.c_str());
+        printf("  %llu packets, %llu without audio, %llu failed, %zu slots\n",
+            (unsigned long long)packets, (unsigned long long)skipped, (unsigned long long)failed, slots.size());
+        printf("  captured over %.1f ms, replayed in %.1f ms\n", capturedMs, wallMs);
+        decode.Print();
+        effect.Print();
+        encode.Print();
+        total.Print();
+        return 0;
+    }
+}
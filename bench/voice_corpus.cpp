@@ -0,0 +1,122 @@
+#include "voice_corpus.h"
+#include "steam_voice.h"
+#include "opus_framedecoder.h"
+#include "crc32.h"
+#include "voice_capture.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace VoiceCorpus {
+    static const uint64_t kSteamID = 0x0110000100000001ull;
+
+    std::vector<int16_t> SyntheticPCM(int samples, uint32_t seed) {
+        std::vector<int16_t> pcm(samples);
+        const double rate = SAMPLERATE_GMOD_OPUS;
+        const double pi = 3.14159265358979323846;
+        double phase = 0;
+        uint32_t rng = seed;
+        for (int i = 0; i < samples; i++) {
+            double t = i / rate;
+            // Pitch glides between 110 and 190 Hz, bursts of ~4 syllables per second
+            double f0 = 150 + 40 * std::sin(2 * pi * 0.7 * t);
+            phase += 2 * pi * f0 / rate;
+            double env = std::pow(std::max(0.0, std::sin(2 * pi * 2 * t)), 0.5);
+            double v = 0;
+            for (int h = 1; h <= 8; h++) v += std::sin(phase * h) / h;
+            rng = rng * 1664525u + 1013904223u;
+            double noise = ((rng >> 9) / 8388608.0 - 1.0) * 0.05;
+            pcm[i] = (int16_t)std::lrint((v * 0.35 * env + noise) * 12000);
+        }
+        return pcm;
+    }
+
+    Packet BuildPacket(uint64_t steamid, const std::vector<std::vector<unsigned char>>& frames, uint16_t firstSeq) {
+        size_t payloadLen = 0;
+        for (const auto& f : frames) payloadLen += 2 * sizeof(uint16_t) + f.size();
+
+        Packet p(sizeof(uint64_t) + 3 + 3 + payloadLen + sizeof(CRC32::CRC32_t));
+        SteamVoice::VoicePacketWriter writer(p.data(), (int)p.size());
+        writer.WriteSteamID(steamid);
+        writer.WriteOp(SteamVoice::OP_SAMPLERATE, SAMPLERATE_GMOD_OPUS);
+
+        int space;
+        char* out = writer.BeginOpusPayload(space);
+        uint16_t seq = firstSeq;
+        for (const auto& f : frames) {
+            uint16_t len = (uint16_t)f.size();
+            memcpy(out, &len, sizeof(len));
+            memcpy(out + sizeof(len), &seq, sizeof(seq));
+            memcpy(out + 2 * sizeof(uint16_t), f.data(), f.size());
+            out += 2 * sizeof(uint16_t) + f.size();
+            seq++;
+        }
+        writer.EndOpusPayload((int)payloadLen);
+        p.resize(writer.Finish());
+        return p;
+    }
+
+    std::vector<Packet> SyntheticPackets(int packets, int framesPerPacket) {
+        std::vector<int16_t> pcm = SyntheticPCM(packets * framesPerPacket * FRAME_SIZE_GMOD);
+        SteamOpus::Opus_FrameDecoder codec;
+        std::vector<Packet> out;
+        std::vector<char> buf(8192);
+        const int chunk = framesPerPacket * FRAME_SIZE_GMOD;
+        for (int i = 0; i < packets; i++) {
+            int n = SteamVoice::CompressIntoBuffer(kSteamID, &codec, (const char*)(pcm.data() + i * chunk), chunk * 2, buf.data(), (int)buf.size(), SAMPLERATE_GMOD_OPUS);
+            if (n > 0) out.emplace_back(buf.begin(), buf.begin() + n);
+        }
+        return out;
+    }
+
+    bool LoadOpusPkt(const std::string& path, std::vector<Packet>& packets, int framesPerPacket) {
+        FILE* f = fopen(path.c_str(), "rb");
+        if (!f) return false;
+
+        char magic[8];
+        if (fread(magic, 1, sizeof(magic), f) != sizeof(magic) || memcmp(magic, "OPUSPKT1", 8) != 0) {
+            fclose(f);
+            return false;
+        }
+
+        std::vector<std::vector<unsigned char>> frames;
+        uint16_t seq = 0;
+        uint16_t len;
+        while (fread(&len, sizeof(len), 1, f) == 1) {
+            std::vector<unsigned char> frame(len);
+            if (fread(frame.data(), 1, len, f) != len) break;
+            frames.push_back(std::move(frame));
+            if ((int)frames.size() == framesPerPacket) {
+                packets.push_back(BuildPacket(kSteamID, frames, seq));
+                seq += (uint16_t)frames.size();
+                frames.clear();
+            }
+        }
+        fclose(f);
+        return !packets.empty();
+    }
+
+    bool LoadCapture(const std::string& path, std::vector<Packet>& packets) {
+        VoiceCaptureReader reader;
+        if (!reader.Open(path)) return false;
+
+        CaptureRecord rec;
+        while (reader.Next(rec)) {
+            if (rec.data.size() > sizeof(uint64_t) + sizeof(CRC32::CRC32_t)) packets.push_back(rec.data);
+        }
+        return !packets.empty();
+    }
+
+    std::vector<Packet> ForOptions(const Bench::Options& opts) {
+        std::vector<Packet> packets;
+        if (!opts.capture.empty()) {
+            if (LoadCapture(opts.capture, packets)) return packets;
+            printf("  could not read %s, using synthetic packets\n", opts.capture.c_str());
+        }
+        if (!opts.opuspkt.empty()) {
+            if (LoadOpusPkt(opts.opuspkt, packets)) return packets;
+            printf("  could not read %s, using synthetic packets\n", opts.opuspkt.c_str());
+        }
+        return SyntheticPackets(250);
+    }
+}
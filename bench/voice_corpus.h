@@ -0,0 +1,28 @@
+// Steam voice packets for the benchmarks, built from synthetic audio or from a recorder .opuspkt file.
+#pragma once
+#include "bench.h"
+#include <vector>
+#include <string>
+#include <cstdint>
+
+namespace VoiceCorpus {
+    typedef std::vector<char> Packet;
+
+    // Speech-like mono PCM at 24 kHz: a gliding harmonic tone with syllable shaped bursts and a little noise
+    std::vector<int16_t> SyntheticPCM(int samples, uint32_t seed = 1);
+
+    // Wraps [len][seq][opus] frames into a full packet: steamid, OP_SAMPLERATE, OP_CODEC_OPUSPLC, CRC
+    Packet BuildPacket(uint64_t steamid, const std::vector<std::vector<unsigned char>>& frames, uint16_t firstSeq);
+
+    // Encodes SyntheticPCM with the module's own codec, framesPerPacket 20 ms frames per packet
+    std::vector<Packet> SyntheticPackets(int packets, int framesPerPacket = 2);
+
+    // Reads a RecorderManager recording and groups its frames into packets. Returns false if unreadable.
+    bool LoadOpusPkt(const std::string& path, std::vector<Packet>& packets, int framesPerPacket = 2);
+
+    // Every packet of a transcript.StartCapture file that carries audio. Returns false if unreadable.
+    bool LoadCapture(const std::string& path, std::vector<Packet>& packets);
+
+    // The capture or recording passed on the command line if any, otherwise 10 seconds of synthetic packets
+    std::vector<Packet> ForOptions(const Bench::Options& opts);
+}
@@ -0,0 +1,447 @@
+#include "audio_effects.h"
+#include "resampler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(_MSC_VER) || defined(__i386__) || defined(__x86_64__)
+#define EFFECTS_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#include <immintrin.h>
+#endif
+
+//The float pipeline's filter only uses SSE2 when the build targets it, it's part of x86-64
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define EFFECTS_SSE2_BASELINE
+#endif
+
+#if defined(EFFECTS_X86) && !defined(_MSC_VER)
+#define EFFECTS_TARGET_SSE2 __attribute__((target("sse2")))
+#define EFFECTS_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define EFFECTS_TARGET_SSE2
+#define EFFECTS_TARGET_AVX2
+#endif
+
+//Fractional bits of the fixed point gain
+#define CRUSH_GAIN_SHIFT 10
+//Desample lowpass passband edge as a share of the lowered Nyquist frequency, same as the resampler's
+#define DESAMPLE_CUTOFF 0.90
+//Fractional bits of the int16 desample coefficients
+#define DESAMPLE_COEFF_SHIFT 15
+//Samples copied behind the filter history at a time
+#define DESAMPLE_CHUNK 480
+
+namespace AudioEffects {
+	//Division of a sample's magnitude (0 to 32768) by the crush factor without dividing, exact for every input.
+	//Unsigned division by an invariant integer, Granlund and Montgomery 1994, figure 4.1 with N = 16.
+	//Every path does the same integer steps, which is what keeps them bit-exact.
+	struct CrushConsts {
+		uint16_t magic;
+		uint16_t divisor;
+		int shift1;
+		int shift2;
+		int16_t gain;
+	};
+
+	static CrushConsts MakeCrushConsts(int quant, float gainFactor) {
+		CrushConsts c;
+		uint32_t d = (uint32_t)std::min(std::max(quant, 1), 65535);
+		int l = 0;
+		while ((1u << l) < d) l++;
+
+		c.magic = (uint16_t)((((uint64_t)1 << 16) * ((1ull << l) - d)) / d + 1);
+		c.divisor = (uint16_t)d;
+		c.shift1 = std::min(l, 1);
+		c.shift2 = std::max(l - 1, 0);
+
+		float gain = std::min(std::max(gainFactor, 0.0f), 32767.0f / (1 << CRUSH_GAIN_SHIFT));
+		c.gain = (int16_t)(gain * (1 << CRUSH_GAIN_SHIFT) + 0.5f);
+		return c;
+	}
+
+	static inline int16_t CrushSample(int16_t s, const CrushConsts& c) {
+		uint16_t a = (uint16_t)(s < 0 ? -(int)s : s);
+		uint16_t t = (uint16_t)(((uint32_t)a * c.magic) >> 16);
+		uint16_t q = (uint16_t)((uint16_t)(t + (uint16_t)((uint16_t)(a - t) >> c.shift1)) >> c.shift2);
+		int v = q * c.divisor;
+		if (s < 0) v = -v;
+
+		v = (v * c.gain + (1 << (CRUSH_GAIN_SHIFT - 1))) >> CRUSH_GAIN_SHIFT;
+		return (int16_t)std::min(std::max(v, -32768), 32767);
+	}
+
+	static void BitCrushScalar(int16_t* buf, int samples, const CrushConsts& c) {
+		for (int i = 0; i < samples; i++) {
+			buf[i] = CrushSample(buf[i], c);
+		}
+	}
+
+	//Lowpass per rate, reversed to line up with the window they're applied to, padded with zeros to DESAMPLE_MAX_TAPS.
+	//Built when the module loads.
+	alignas(32) static int16_t desampleCoeffs[DESAMPLE_MAX_RATE + 1][DESAMPLE_MAX_TAPS];
+	alignas(32) static float desampleCoeffsFloat[DESAMPLE_MAX_RATE + 1][DESAMPLE_MAX_TAPS];
+
+	static void BuildDesampleCoeffs() {
+		for (int rate = 2; rate <= DESAMPLE_MAX_RATE; rate++) {
+			const int taps = rate * DESAMPLE_TAPS_PER_RATE;
+			std::vector<double> h = KaiserLowPass(taps, DESAMPLE_CUTOFF * 0.5 / rate);
+			for (int k = 0; k < taps; k++) {
+				desampleCoeffs[rate][taps - 1 - k] = (int16_t)std::lround(h[k] * (1 << DESAMPLE_COEFF_SHIFT));
+				desampleCoeffsFloat[rate][taps - 1 - k] = (float)h[k];
+			}
+		}
+	}
+
+	//Filter output for the window ending at x[taps - 1]. Integer sums, so every path gets the same result.
+	//No coefficient reaches 1, so the sum stays well inside 32 bits.
+	typedef int16_t (*DesampleDotFn)(const int16_t* h, const int16_t* x, int taps);
+
+	static inline int16_t RoundCoeffSum(int32_t sum) {
+		int v = (sum + (1 << (DESAMPLE_COEFF_SHIFT - 1))) >> DESAMPLE_COEFF_SHIFT;
+		return (int16_t)std::min(std::max(v, -32768), 32767);
+	}
+
+	static int16_t DesampleDotScalar(const int16_t* h, const int16_t* x, int taps) {
+		int32_t sum = 0;
+		for (int i = 0; i < taps; i++) {
+			sum += h[i] * x[i];
+		}
+		return RoundCoeffSum(sum);
+	}
+
+	static float DesampleDotFloat(const float* h, const float* x, int taps) {
+#ifdef EFFECTS_SSE2_BASELINE
+		__m128 acc0 = _mm_setzero_ps();
+		__m128 acc1 = _mm_setzero_ps();
+		for (int i = 0; i < taps; i += 8) {
+			acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_load_ps(h + i), _mm_loadu_ps(x + i)));
+			acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_load_ps(h + i + 4), _mm_loadu_ps(x + i + 4)));
+		}
+		__m128 acc = _mm_add_ps(acc0, acc1);
+		acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+		acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+		return _mm_cvtss_f32(acc);
+#else
+		float sum = 0.0f;
+		for (int i = 0; i < taps; i++) {
+			sum += h[i] * x[i];
+		}
+		return sum;
+#endif
+	}
+
+	//Filters the packet behind the stream's history and holds each result for rate samples, in place.
+	//The filter is only evaluated where a new held sample starts, which is what keeps it cheap.
+	template <typename T, typename Dot>
+	static void DesampleStream(T* buf, int samples, int rate, T* history, T& held, int& hold, const T* coeffs, Dot dot) {
+		const int taps = rate * DESAMPLE_TAPS_PER_RATE;
+		const int hist = taps - 1;
+		T work[DESAMPLE_MAX_TAPS - 1 + DESAMPLE_CHUNK];
+		memcpy(work, history, hist * sizeof(T));
+
+		for (int start = 0; start < samples; start += DESAMPLE_CHUNK) {
+			int n = std::min(DESAMPLE_CHUNK, samples - start);
+			memcpy(work + hist, buf + start, n * sizeof(T));
+
+			for (int i = 0; i < n; ) {
+				if (hold == 0) {
+					//Window of taps inputs ending at sample i
+					held = dot(coeffs, work + i, taps);
+					hold = rate;
+				}
+				int run = std::min(hold, n - i);
+				std::fill(buf + start + i, buf + start + i + run, held);
+				hold -= run;
+				i += run;
+			}
+			memmove(work, work + n, hist * sizeof(T));
+		}
+		memcpy(history, work, hist * sizeof(T));
+	}
+
+	void DesampleState::Reset(int newRate) {
+		rate = newRate;
+		hold = 0;
+		held = 0;
+		heldFloat = 0.0f;
+		memset(history, 0, sizeof(history));
+		memset(historyFloat, 0, sizeof(historyFloat));
+	}
+
+	//Clamps the rate and starts the state over if the rate changed. Outputs false to leave the audio as it is.
+	static bool PrepareDesample(int& rate, DesampleState& state) {
+		if (rate < 2)
+			return false;
+		rate = std::min(rate, DESAMPLE_MAX_RATE);
+
+		if (state.rate != rate) {
+			state.Reset(rate);
+		}
+		return true;
+	}
+
+#ifdef EFFECTS_X86
+	EFFECTS_TARGET_SSE2
+	static void BitCrushSSE2(int16_t* buf, int samples, const CrushConsts& c) {
+		const __m128i magic = _mm_set1_epi16((short)c.magic);
+		const __m128i divisor = _mm_set1_epi16((short)c.divisor);
+		const __m128i shift1 = _mm_cvtsi32_si128(c.shift1);
+		const __m128i shift2 = _mm_cvtsi32_si128(c.shift2);
+		const __m128i gain = _mm_set1_epi16(c.gain);
+		const __m128i round = _mm_set1_epi32(1 << (CRUSH_GAIN_SHIFT - 1));
+
+		int i = 0;
+		for (; i + 8 <= samples; i += 8) {
+			__m128i s = _mm_loadu_si128((const __m128i*)(buf + i));
+			__m128i sign = _mm_srai_epi16(s, 15);
+			__m128i a = _mm_sub_epi16(_mm_xor_si128(s, sign), sign);
+
+			__m128i t = _mm_mulhi_epu16(a, magic);
+			__m128i q = _mm_srl_epi16(_mm_add_epi16(t, _mm_srl_epi16(_mm_sub_epi16(a, t), shift1)), shift2);
+			__m128i v = _mm_mullo_epi16(q, divisor);
+			v = _mm_sub_epi16(_mm_xor_si128(v, sign), sign);
+
+			//32-bit products, rounded and packed back with saturation
+			__m128i lo = _mm_mullo_epi16(v, gain);
+			__m128i hi = _mm_mulhi_epi16(v, gain);
+			__m128i p0 = _mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi16(lo, hi), round), CRUSH_GAIN_SHIFT);
+			__m128i p1 = _mm_srai_epi32(_mm_add_epi32(_mm_unpackhi_epi16(lo, hi), round), CRUSH_GAIN_SHIFT);
+			_mm_storeu_si128((__m128i*)(buf + i), _mm_packs_epi32(p0, p1));
+		}
+		BitCrushScalar(buf + i, samples - i, c);
+	}
+
+	EFFECTS_TARGET_SSE2
+	static int16_t DesampleDotSSE2(const int16_t* h, const int16_t* x, int taps) {
+		__m128i acc = _mm_setzero_si128();
+		for (int i = 0; i < taps; i += 8) {
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_load_si128((const __m128i*)(h + i)), _mm_loadu_si128((const __m128i*)(x + i))));
+		}
+		acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0x4E));
+		acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0xB1));
+		return RoundCoeffSum(_mm_cvtsi128_si32(acc));
+	}
+
+	EFFECTS_TARGET_AVX2
+	static void BitCrushAVX2(int16_t* buf, int samples, const CrushConsts& c) {
+		const __m256i magic = _mm256_set1_epi16((short)c.magic);
+		const __m256i divisor = _mm256_set1_epi16((short)c.divisor);
+		const __m128i shift1 = _mm_cvtsi32_si128(c.shift1);
+		const __m128i shift2 = _mm_cvtsi32_si128(c.shift2);
+		const __m256i gain = _mm256_set1_epi16(c.gain);
+		const __m256i round = _mm256_set1_epi32(1 << (CRUSH_GAIN_SHIFT - 1));
+
+		int i = 0;
+		for (; i + 16 <= samples; i += 16) {
+			__m256i s = _mm256_loadu_si256((const __m256i*)(buf + i));
+			__m256i sign = _mm256_srai_epi16(s, 15);
+			__m256i a = _mm256_sub_epi16(_mm256_xor_si256(s, sign), sign);
+
+			__m256i t = _mm256_mulhi_epu16(a, magic);
+			__m256i q = _mm256_srl_epi16(_mm256_add_epi16(t, _mm256_srl_epi16(_mm256_sub_epi16(a, t), shift1)), shift2);
+			__m256i v = _mm256_mullo_epi16(q, divisor);
+			v = _mm256_sub_epi16(_mm256_xor_si256(v, sign), sign);
+
+			//Unpack and pack both work within 128-bit lanes, so the samples come back in order
+			__m256i lo = _mm256_mullo_epi16(v, gain);
+			__m256i hi = _mm256_mulhi_epi16(v, gain);
+			__m256i p0 = _mm256_srai_epi32(_mm256_add_epi32(_mm256_unpacklo_epi16(lo, hi), round), CRUSH_GAIN_SHIFT);
+			__m256i p1 = _mm256_srai_epi32(_mm256_add_epi32(_mm256_unpackhi_epi16(lo, hi), round), CRUSH_GAIN_SHIFT);
+			_mm256_storeu_si256((__m256i*)(buf + i), _mm256_packs_epi32(p0, p1));
+		}
+		//GCC leaves this out of target("avx2") functions, and legacy SSE code after dirty upper halves stalls
+		_mm256_zeroupper();
+		BitCrushScalar(buf + i, samples - i, c);
+	}
+
+	EFFECTS_TARGET_AVX2
+	static int16_t DesampleDotAVX2(const int16_t* h, const int16_t* x, int taps) {
+		//taps is a multiple of DESAMPLE_TAPS_PER_RATE, 16
+		__m256i acc = _mm256_setzero_si256();
+		for (int i = 0; i < taps; i += 16) {
+			acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_load_si256((const __m256i*)(h + i)), _mm256_loadu_si256((const __m256i*)(x + i))));
+		}
+		__m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+		_mm256_zeroupper();
+		sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+		sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+		return RoundCoeffSum(_mm_cvtsi128_si32(sum));
+	}
+
+	static void CpuFeatures(bool& sse2, bool& avx2) {
+		unsigned int regs[4] = {};
+#if defined(_MSC_VER)
+		__cpuid((int*)regs, 1);
+#else
+		if (!__get_cpuid(1, &regs[0], &regs[1], &regs[2], &regs[3]))
+			return;
+#endif
+		sse2 = (regs[3] & (1u << 26)) != 0;
+		bool osxsave = (regs[2] & (1u << 27)) != 0;
+		if (!osxsave)
+			return;
+
+		//The OS has to save the YMM registers on context switches
+		uint64_t xcr0;
+#if defined(_MSC_VER)
+		xcr0 = _xgetbv(0);
+#else
+		unsigned int eax, edx;
+		__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		xcr0 = ((uint64_t)edx << 32) | eax;
+#endif
+		if ((xcr0 & 6) != 6)
+			return;
+
+#if defined(_MSC_VER)
+		__cpuidex((int*)regs, 7, 0);
+#else
+		if (__get_cpuid_max(0, nullptr) < 7)
+			return;
+		__cpuid_count(7, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+		avx2 = (regs[1] & (1u << 5)) != 0;
+	}
+#endif
+
+	typedef void (*BitCrushFn)(int16_t* buf, int samples, const CrushConsts& c);
+
+	static const BitCrushFn bitCrushImpls[IMPL_COUNT] = {
+		BitCrushScalar,
+#ifdef EFFECTS_X86
+		BitCrushSSE2,
+		BitCrushAVX2,
+#else
+		nullptr,
+		nullptr,
+#endif
+	};
+
+	static const DesampleDotFn desampleImpls[IMPL_COUNT] = {
+		DesampleDotScalar,
+#ifdef EFFECTS_X86
+		DesampleDotSSE2,
+		DesampleDotAVX2,
+#else
+		nullptr,
+		nullptr,
+#endif
+	};
+
+	static bool supported[IMPL_COUNT];
+	static Impl active = IMPL_SCALAR;
+
+	static struct Setup {
+		Setup() {
+			supported[IMPL_SCALAR] = true;
+#ifdef EFFECTS_X86
+			CpuFeatures(supported[IMPL_SSE2], supported[IMPL_AVX2]);
+			supported[IMPL_AVX2] = supported[IMPL_AVX2] && supported[IMPL_SSE2];
+#endif
+			active = supported[IMPL_AVX2] ? IMPL_AVX2 : supported[IMPL_SSE2] ? IMPL_SSE2 : IMPL_SCALAR;
+			BuildDesampleCoeffs();
+		}
+	} setup;
+
+	bool Supported(Impl impl) {
+		return impl >= 0 && impl < IMPL_COUNT && supported[impl];
+	}
+
+	Impl ActiveImpl() {
+		return active;
+	}
+
+	bool SetImpl(Impl impl) {
+		if (!Supported(impl))
+			return false;
+		active = impl;
+		return true;
+	}
+
+	const char* ImplName(Impl impl) {
+		static const char* names[IMPL_COUNT] = { "scalar", "sse2", "avx2" };
+		return impl >= 0 && impl < IMPL_COUNT ? names[impl] : "unknown";
+	}
+
+	void BitCrushWith(Impl impl, int16_t* sampleBuffer, int samples, int quant, float gainFactor) {
+		if (!Supported(impl))
+			impl = IMPL_SCALAR;
+		bitCrushImpls[impl](sampleBuffer, samples, MakeCrushConsts(quant, gainFactor));
+	}
+
+	void DesampleWith(Impl impl, int16_t* inBuffer, int samples, int desampleRate, DesampleState* state) {
+		if (state == nullptr) {
+			DesampleState fresh;
+			DesampleWith(impl, inBuffer, samples, desampleRate, &fresh);
+			return;
+		}
+		if (!PrepareDesample(desampleRate, *state))
+			return;
+		if (!Supported(impl))
+			impl = IMPL_SCALAR;
+		DesampleStream(inBuffer, samples, desampleRate, state->history, state->held, state->hold, desampleCoeffs[desampleRate], desampleImpls[impl]);
+	}
+
+	void BitCrush(int16_t* sampleBuffer, int samples, int quant, float gainFactor) {
+		BitCrushWith(active, sampleBuffer, samples, quant, gainFactor);
+	}
+
+	void Desample(int16_t* inBuffer, int samples, int desampleRate, DesampleState* state) {
+		DesampleWith(active, inBuffer, samples, desampleRate, state);
+	}
+
+	void Desample(float* inBuffer, int samples, int desampleRate, DesampleState* state) {
+		if (state == nullptr) {
+			DesampleState fresh;
+			Desample(inBuffer, samples, desampleRate, &fresh);
+			return;
+		}
+		if (!PrepareDesample(desampleRate, *state))
+			return;
+		DesampleStream(inBuffer, samples, desampleRate, state->historyFloat, state->heldFloat, state->hold, desampleCoeffsFloat[desampleRate], DesampleDotFloat);
+	}
+
+	void BitCrush(float* sampleBuffer, int samples, float quant, float gainFactor) {
+		//Same steps as the int16 version, scaled to floats: the same ranges for quant and the gain, the gain in the
+		//same 1/1024 steps, and the magnitude rounded towards zero like MakeCrushConsts' division. trunc keeps any sample out of int range defined.
+		quant = std::min(std::max(quant, 1.0f), 65535.0f);
+		gainFactor = std::min(std::max(gainFactor, 0.0f), 32767.0f / (1 << CRUSH_GAIN_SHIFT));
+		gainFactor = std::floor(gainFactor * (1 << CRUSH_GAIN_SHIFT) + 0.5f) / (1 << CRUSH_GAIN_SHIFT);
+		float step = quant / 32768.0f;
+		float invStep = 1.0f / step;
+		float scale = step * gainFactor;
+		for (int i = 0; i < samples; i++) {
+			float f = std::trunc(sampleBuffer[i] * invStep) * scale;
+			sampleBuffer[i] = std::min(std::max(f, -1.0f), 1.0f);
+		}
+	}
+
+	template <typename T>
+	static void ApplySpan(T* sampleBuffer, int samples, const EffectParams& params, EffectState* state) {
+		switch (params.effect) {
+		case EFF_BITCRUSH:
+			BitCrush(sampleBuffer, samples, params.crushFactor, params.gainFactor);
+			break;
+		case EFF_DESAMPLE:
+			Desample(sampleBuffer, samples, params.desampleRate, state != nullptr ? &state->desample : nullptr);
+			break;
+		default:
+			break;
+		}
+	}
+
+	void Apply(int16_t* sampleBuffer, int samples, const EffectParams& params, EffectState* state) {
+		ApplySpan(sampleBuffer, samples, params, state);
+	}
+
+	void Apply(float* sampleBuffer, int samples, const EffectParams& params, EffectState* state) {
+		ApplySpan(sampleBuffer, samples, params, state);
+	}
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <cstdint>
+
+namespace AudioEffects {
+	enum {
+		EFF_NONE,
+		EFF_BITCRUSH,
+		EFF_DESAMPLE
+	};
+
+	//Snapshot of the effect settings for one packet, so the effect can run off the game thread.
+	struct EffectParams {
+		int effect = EFF_NONE;
+		int crushFactor = 350;
+		float gainFactor = 1.2f;
+		int desampleRate = 2;
+	};
+
+	//Highest EFF_DESAMPLE rate, higher ones are clamped to it
+	#define DESAMPLE_MAX_RATE 16
+	//Lowpass length per step of the rate. The filter is only evaluated once per step, so this is its cost per sample.
+	#define DESAMPLE_TAPS_PER_RATE 16
+	#define DESAMPLE_MAX_TAPS (DESAMPLE_MAX_RATE * DESAMPLE_TAPS_PER_RATE)
+
+	//Where EFF_DESAMPLE left off in a stream, so the filter and the held sample carry on across packets
+	struct DesampleState {
+		int rate = 0;
+		//Samples left before the filter is evaluated again
+		int hold = 0;
+		int16_t held = 0;
+		float heldFloat = 0.0f;
+		//The last taps - 1 inputs, oldest first. One per pipeline, whichever the stream goes through.
+		int16_t history[DESAMPLE_MAX_TAPS];
+		float historyFloat[DESAMPLE_MAX_TAPS];
+
+		DesampleState() { Reset(0); }
+		void Reset(int newRate);
+	};
+
+	//Per stream memory of the effects, kept by the stream's codec
+	struct EffectState {
+		DesampleState desample;
+
+		void Reset() { desample.Reset(0); }
+	};
+
+	//Implementations of the int16 kernels. The best one the CPU supports is picked when the module loads.
+	//They all give exactly the same output.
+	enum Impl {
+		IMPL_SCALAR,
+		IMPL_SSE2,	//8 samples per step (x86)
+		IMPL_AVX2,	//16 samples per step (x86 with AVX2 and OS support for it)
+		IMPL_COUNT
+	};
+
+	bool Supported(Impl impl);
+	Impl ActiveImpl();
+	//Switches the int16 effects to impl. Outputs false if the CPU doesn't support it.
+	bool SetImpl(Impl impl);
+	const char* ImplName(Impl impl);
+
+	//Rounds each sample towards zero to a multiple of quant (1 to 65535), then applies the gain (0 to 32), saturating.
+	//The gain is applied in 1/1024 steps.
+	void BitCrush(int16_t* sampleBuffer, int samples, int quant, float gainFactor);
+
+	//Lowers the sample rate by desampleRate without changing the sample count: lowpass filters below the new
+	//Nyquist frequency, then holds every desampleRate-th filtered sample for desampleRate samples.
+	//Rates below 2 leave the buffer as it is. Without a state every call starts from silence.
+	void Desample(int16_t* inBuffer, int samples, int desampleRate = 2, DesampleState* state = nullptr);
+
+	//Same, with a specific implementation. For benchmarks and self checks.
+	void BitCrushWith(Impl impl, int16_t* sampleBuffer, int samples, int quant, float gainFactor);
+	void DesampleWith(Impl impl, int16_t* inBuffer, int samples, int desampleRate = 2, DesampleState* state = nullptr);
+
+	//Runs the effect selected in params on one packet of the stream state belongs to. Never changes the sample count.
+	void Apply(int16_t* sampleBuffer, int samples, const EffectParams& params, EffectState* state = nullptr);
+
+	//Float pipeline versions, samples in [-1, 1). The crush factor is still in int16 steps.
+	//BitCrush clamps and rounds like the int16 version, so the two pipelines agree to within one int16 step.
+	void BitCrush(float* sampleBuffer, int samples, float quant, float gainFactor);
+	void Desample(float* inBuffer, int samples, int desampleRate = 2, DesampleState* state = nullptr);
+	void Apply(float* sampleBuffer, int samples, const EffectParams& params, EffectState* state = nullptr);
+}
@@ -0,0 +1,158 @@
+#include "codec_pool.h"
+#include "opus_framedecoder.h"
+#include <opus.h>
+#include <cstdint>
+#include <cstdlib>
+
+namespace SteamOpus {
+    StateArena::StateArena(size_t slotSize) : slotSize((slotSize + 63) & ~(size_t)63) {}
+
+    StateArena::~StateArena() {
+        for (unsigned char* block : blocks) free(block);
+    }
+
+    void StateArena::Grow() {
+        // Over-allocated by a line, the first slot starts on the next boundary
+        unsigned char* block = (unsigned char*)malloc(slotSize * CODEC_POOL_BLOCK + 63);
+        if (block == nullptr)
+            return;
+
+        blocks.push_back(block);
+        unsigned char* base = (unsigned char*)(((uintptr_t)block + 63) & ~(uintptr_t)63);
+        // Back to front, so slots go out in address order
+        for (int i = CODEC_POOL_BLOCK - 1; i >= 0; i--)
+            freeSlots.push_back(base + i * slotSize);
+    }
+
+    void* StateArena::Acquire() {
+        if (freeSlots.empty())
+            Grow();
+        if (freeSlots.empty())
+            return nullptr;
+
+        void* slot = freeSlots.back();
+        freeSlots.pop_back();
+        return slot;
+    }
+
+    void StateArena::Release(void* slot) {
+        freeSlots.push_back(slot);
+    }
+
+    void StateArena::Reserve(int slots) {
+        while (Capacity() < slots) {
+            size_t before = blocks.size();
+            Grow();
+            if (blocks.size() == before)
+                return;
+        }
+    }
+
+    CodecPool::CodecPool(int reserve) : states(Opus_FrameDecoder::StateSize()) {
+        Reserve(reserve);
+    }
+
+    CodecPool::~CodecPool() {
+        for (Opus_FrameDecoder* codec : all) delete codec;
+    }
+
+    void CodecPool::Grow() {
+        // A codec keeps its slot for life, the arena only hands them out once
+        for (int i = 0; i < CODEC_POOL_BLOCK; i++) {
+            void* state = states.Acquire();
+            if (state == nullptr)
+                return;
+
+            Opus_FrameDecoder* codec = new Opus_FrameDecoder(state, this);
+            all.push_back(codec);
+            freeCodecs.push_back(codec);
+        }
+    }
+
+    void CodecPool::Reserve(int codecs) {
+        std::lock_guard<std::mutex> lock(mtx);
+        while ((int)all.size() < codecs) {
+            size_t before = all.size();
+            Grow();
+            if (all.size() == before)
+                return;
+        }
+    }
+
+    Opus_FrameDecoder* CodecPool::Acquire() {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (freeCodecs.empty())
+            Grow();
+        if (freeCodecs.empty())
+            return nullptr;
+
+        Opus_FrameDecoder* codec = freeCodecs.back();
+        freeCodecs.pop_back();
+        return codec;
+    }
+
+    void CodecPool::Return(Opus_FrameDecoder* codec) {
+        // Reset on the way in, so Acquire hands out a clean codec without any work
+        codec->ResetState();
+        std::lock_guard<std::mutex> lock(mtx);
+        freeCodecs.push_back(codec);
+    }
+
+    int CodecPool::Capacity() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return (int)all.size();
+    }
+
+    int CodecPool::InUse() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return (int)(all.size() - freeCodecs.size());
+    }
+
+    size_t CodecPool::Bytes() {
+        std::lock_guard<std::mutex> lock(mtx);
+        // Each codec's jitter buffer is sized for the current depth the next time it decodes
+        size_t perCodec = sizeof(Opus_FrameDecoder) + SteamVoice::JitterBuffer::BytesFor(Loss::JitterDepth());
+        // Plus the decoders codecs in use created for formats other than their own
+        return states.Bytes() + all.size() * perCodec + SteamVoice::FormatDecoders::TotalBytes();
+    }
+
+    EncoderPool::EncoderPool() : states(opus_encoder_get_size(1)) {
+        states.Reserve(CODEC_POOL_BLOCK);
+    }
+
+    OpusEncoder* EncoderPool::Acquire(int sampleRate, int application) {
+        std::lock_guard<std::mutex> lock(mtx);
+        OpusEncoder* encoder = (OpusEncoder*)states.Acquire();
+        if (encoder == nullptr)
+            return nullptr;
+
+        if (opus_encoder_init(encoder, sampleRate, 1, application) != OPUS_OK) {
+            states.Release(encoder);
+            return nullptr;
+        }
+        return encoder;
+    }
+
+    void EncoderPool::Release(OpusEncoder* encoder) {
+        if (encoder == nullptr)
+            return;
+
+        std::lock_guard<std::mutex> lock(mtx);
+        states.Release(encoder);
+    }
+
+    int EncoderPool::Capacity() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return states.Capacity();
+    }
+
+    int EncoderPool::InUse() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return states.InUse();
+    }
+
+    size_t EncoderPool::Bytes() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return states.Bytes();
+    }
+}
@@ -0,0 +1,89 @@
+// Opus codecs set up ahead of time in contiguous blocks, so giving a player an effect or starting
+// a recording only takes one off a free list instead of reaching opus_*_create and the allocator.
+#pragma once
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+struct OpusEncoder;
+
+// Slots per block. A block of codecs is about 800 KB.
+#define CODEC_POOL_BLOCK 16
+
+namespace SteamOpus {
+    class Opus_FrameDecoder;
+
+    // Fixed size, cache line aligned slots carved out of blocks. Grows a block at a time, never shrinks.
+    // Not thread safe, the pools lock around it.
+    class StateArena {
+    public:
+        explicit StateArena(size_t slotSize);
+        ~StateArena();
+
+        StateArena(const StateArena&) = delete;
+        StateArena& operator=(const StateArena&) = delete;
+
+        void* Acquire();
+        void Release(void* slot);
+        // Grows until there are at least this many slots
+        void Reserve(int slots);
+
+        int Capacity() const { return (int)blocks.size() * CODEC_POOL_BLOCK; }
+        int InUse() const { return Capacity() - (int)freeSlots.size(); }
+        size_t Bytes() const { return blocks.size() * slotSize * CODEC_POOL_BLOCK; }
+
+    private:
+        void Grow();
+
+        size_t slotSize;
+        std::vector<unsigned char*> blocks;
+        std::vector<void*> freeSlots;
+    };
+
+    // Opus_FrameDecoders whose decoder and encoder sit in a StateArena. Release() on a codec hands it back.
+    class CodecPool {
+    public:
+        explicit CodecPool(int reserve = CODEC_POOL_BLOCK);
+        // Every codec has to be back by now
+        ~CodecPool();
+
+        CodecPool(const CodecPool&) = delete;
+        CodecPool& operator=(const CodecPool&) = delete;
+
+        // A codec reset for a new stream. Only allocates if every codec is out.
+        Opus_FrameDecoder* Acquire();
+        void Return(Opus_FrameDecoder* codec);
+        // Makes sure at least this many codecs exist
+        void Reserve(int codecs);
+
+        int Capacity();
+        int InUse();
+        size_t Bytes();
+
+    private:
+        void Grow();
+
+        std::mutex mtx;
+        StateArena states;
+        std::vector<Opus_FrameDecoder*> all;
+        std::vector<Opus_FrameDecoder*> freeCodecs;
+    };
+
+    // Bare encoders, for the recorder's sessions
+    class EncoderPool {
+    public:
+        EncoderPool();
+
+        // An encoder set up for the rate and application, nullptr if libopus rejects them
+        OpusEncoder* Acquire(int sampleRate, int application);
+        void Release(OpusEncoder* encoder);
+
+        int Capacity();
+        int InUse();
+        size_t Bytes();
+
+    private:
+        std::mutex mtx;
+        StateArena states;
+    };
+}
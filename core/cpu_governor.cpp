@@ -0,0 +1,34 @@
+#include "cpu_governor.h"
+#include <algorithm>
+
+void CpuGovernor::SetBudget(double usPerTick, int minComplexity) {
+    budgetNs = usPerTick > 0 ? (uint64_t)(usPerTick * 1000.0) : 0;
+    this->minComplexity = std::min(std::max(minComplexity, 0), CPU_GOVERNOR_MAX_COMPLEXITY);
+
+    int c = cap.load(std::memory_order_relaxed);
+    if (budgetNs == 0) c = CPU_GOVERNOR_MAX_COMPLEXITY;
+    cap.store(std::max(c, this->minComplexity), std::memory_order_relaxed);
+}
+
+void CpuGovernor::Tick() {
+    windowNs += work.exchange(0, std::memory_order_relaxed);
+    if (++ticks < CPU_GOVERNOR_WINDOW_TICKS)
+        return;
+
+    uint64_t avgNs = windowNs / ticks;
+    usPerTick = avgNs / 1000.0;
+    windowNs = 0;
+    ticks = 0;
+
+    if (budgetNs == 0)
+        return;
+
+    // One step per window, so the new cap has had a full window to show its effect before the next change
+    int c = cap.load(std::memory_order_relaxed);
+    if (avgNs > budgetNs && c > minComplexity) {
+        cap.store(c - 1, std::memory_order_relaxed);
+    }
+    else if (avgNs < budgetNs * CPU_GOVERNOR_HEADROOM && c < CPU_GOVERNOR_MAX_COMPLEXITY) {
+        cap.store(c + 1, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,53 @@
+// Keeps voice re-encoding inside a CPU budget per server tick.
+// Voice hook time is summed from every thread that does its work, and once per tick the game thread compares the
+// average over a window of ticks with the budget. Over budget lowers the Opus complexity cap by one step,
+// enough headroom raises it again. Encoders pick the cap up the next time they encode.
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#define CPU_GOVERNOR_WINDOW_TICKS 16
+#define CPU_GOVERNOR_MAX_COMPLEXITY 10
+// Fraction of the budget the average has to drop under before the cap goes back up
+#define CPU_GOVERNOR_HEADROOM 0.6
+
+class CpuGovernor {
+public:
+    // Microseconds of voice hook work allowed per tick. 0 turns the governor off and lifts the cap.
+    // The cap never goes below minComplexity.
+    void SetBudget(double usPerTick, int minComplexity);
+
+    // Any thread
+    void AddWork(uint64_t ns) { work.fetch_add(ns, std::memory_order_relaxed); }
+    int ComplexityCap() const { return cap.load(std::memory_order_relaxed); }
+
+    // Game thread, once per tick
+    void Tick();
+
+    // Game thread. Average over the last full window.
+    double UsPerTick() const { return usPerTick; }
+    double BudgetUs() const { return budgetNs / 1000.0; }
+
+    // Adds the time until the end of the enclosing scope
+    class Scope {
+    public:
+        explicit Scope(CpuGovernor& governor) : governor(governor), start(std::chrono::steady_clock::now()) {}
+        ~Scope() {
+            governor.AddWork((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        }
+
+    private:
+        CpuGovernor& governor;
+        std::chrono::steady_clock::time_point start;
+    };
+
+private:
+    std::atomic<uint64_t> work{0};
+    std::atomic<int> cap{CPU_GOVERNOR_MAX_COMPLEXITY};
+    uint64_t budgetNs = 0;
+    int minComplexity = 0;
+    int ticks = 0;
+    uint64_t windowNs = 0;
+    double usPerTick = 0;
+};
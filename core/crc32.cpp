@@ -0,0 +1,232 @@
+#include "crc32.h"
+#include <cstring>
+
+#if defined(_MSC_VER) || defined(__i386__) || defined(__x86_64__)
+#define CRC32_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+#if defined(CRC32_X86) && !defined(_MSC_VER)
+#define CRC32_TARGET_PCLMUL __attribute__((target("pclmul,sse2")))
+#else
+#define CRC32_TARGET_PCLMUL
+#endif
+
+namespace CRC32 {
+    // All the implementations work on the raw register: start at ~0, xor with ~0 at the end
+    typedef uint32_t (*UpdateFn)(uint32_t crc, const unsigned char* p, size_t len);
+
+    static uint32_t tables[8][256];
+
+    static uint32_t UpdateBytewise(uint32_t crc, const unsigned char* p, size_t len) {
+        for (size_t i = 0; i < len; i++)
+            crc = tables[0][(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+        return crc;
+    }
+
+    static uint32_t UpdateSlice8(uint32_t crc, const unsigned char* p, size_t len) {
+        while (len >= 8) {
+            uint32_t lo, hi;
+            memcpy(&lo, p, sizeof(lo));
+            memcpy(&hi, p + 4, sizeof(hi));
+            lo ^= crc;
+            crc = tables[7][lo & 0xFF] ^ tables[6][(lo >> 8) & 0xFF] ^ tables[5][(lo >> 16) & 0xFF] ^ tables[4][lo >> 24] ^
+                  tables[3][hi & 0xFF] ^ tables[2][(hi >> 8) & 0xFF] ^ tables[1][(hi >> 16) & 0xFF] ^ tables[0][hi >> 24];
+            p += 8;
+            len -= 8;
+        }
+        return UpdateBytewise(crc, p, len);
+    }
+
+#ifdef CRC32_X86
+    // Folding with carry-less multiplies, after Intel's "Fast CRC Computation for Generic Polynomials Using
+    // PCLMULQDQ Instruction" with the bit-reflected constants from the end of the paper (as used by zlib/Chromium).
+    // Handles the largest multiple of 16 bytes (at least 64), the tail goes through slice-by-8.
+    CRC32_TARGET_PCLMUL
+    static uint32_t UpdatePclmul(uint32_t crc, const unsigned char* p, size_t len) {
+        if (len < 64)
+            return UpdateSlice8(crc, p, len);
+
+        alignas(16) static const uint64_t k1k2[] = { 0x0154442bd4ull, 0x01c6e41596ull };
+        alignas(16) static const uint64_t k3k4[] = { 0x01751997d0ull, 0x00ccaa009eull };
+        alignas(16) static const uint64_t k5k0[] = { 0x0163cd6124ull, 0x0000000000ull };
+        alignas(16) static const uint64_t poly[] = { 0x01db710641ull, 0x01f7011641ull };
+
+        size_t tail = len & 15;
+        len -= tail;
+
+        __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+        x1 = _mm_loadu_si128((const __m128i*)(p + 0x00));
+        x2 = _mm_loadu_si128((const __m128i*)(p + 0x10));
+        x3 = _mm_loadu_si128((const __m128i*)(p + 0x20));
+        x4 = _mm_loadu_si128((const __m128i*)(p + 0x30));
+        x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+        x0 = _mm_load_si128((const __m128i*)k1k2);
+        p += 64;
+        len -= 64;
+
+        // Four lanes of 128 bits in parallel
+        while (len >= 64) {
+            x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+            x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+            x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+            x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+            x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+            x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+            x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+            x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+            y5 = _mm_loadu_si128((const __m128i*)(p + 0x00));
+            y6 = _mm_loadu_si128((const __m128i*)(p + 0x10));
+            y7 = _mm_loadu_si128((const __m128i*)(p + 0x20));
+            y8 = _mm_loadu_si128((const __m128i*)(p + 0x30));
+
+            x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+            x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+            x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+            x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+
+            p += 64;
+            len -= 64;
+        }
+
+        // Fold the four lanes into one
+        x0 = _mm_load_si128((const __m128i*)k3k4);
+
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+        // Remaining 16 byte blocks
+        while (len >= 16) {
+            x2 = _mm_loadu_si128((const __m128i*)p);
+
+            x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+            x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+            x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+            p += 16;
+            len -= 16;
+        }
+
+        // 128 -> 64 bits
+        x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+        x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+        x1 = _mm_srli_si128(x1, 8);
+        x1 = _mm_xor_si128(x1, x2);
+
+        x0 = _mm_loadl_epi64((const __m128i*)k5k0);
+
+        x2 = _mm_srli_si128(x1, 4);
+        x1 = _mm_and_si128(x1, x3);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_xor_si128(x1, x2);
+
+        // Barrett reduction to 32 bits
+        x0 = _mm_load_si128((const __m128i*)poly);
+
+        x2 = _mm_and_si128(x1, x3);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+        x2 = _mm_and_si128(x2, x3);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x1 = _mm_xor_si128(x1, x2);
+
+        crc = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(x1, 4));
+        return UpdateSlice8(crc, p, tail);
+    }
+
+    static bool CpuHasPclmul() {
+        unsigned int regs[4] = {};
+#if defined(_MSC_VER)
+        __cpuid((int*)regs, 1);
+#else
+        if (!__get_cpuid(1, &regs[0], &regs[1], &regs[2], &regs[3]))
+            return false;
+#endif
+        bool sse2 = (regs[3] & (1u << 26)) != 0;
+        bool pclmul = (regs[2] & (1u << 1)) != 0;
+        return sse2 && pclmul;
+    }
+#endif
+
+    static const UpdateFn impls[IMPL_COUNT] = {
+        UpdateBytewise,
+        UpdateSlice8,
+#ifdef CRC32_X86
+        UpdatePclmul,
+#else
+        nullptr,
+#endif
+    };
+
+    static bool supported[IMPL_COUNT];
+    static Impl active = IMPL_BYTEWISE;
+
+    static struct Setup {
+        Setup() {
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++)
+                    c = (c >> 1) ^ (0xEDB88320u & (0u - (c & 1)));
+                tables[0][i] = c;
+            }
+            for (int t = 1; t < 8; t++) {
+                for (int i = 0; i < 256; i++)
+                    tables[t][i] = (tables[t - 1][i] >> 8) ^ tables[0][tables[t - 1][i] & 0xFF];
+            }
+
+            supported[IMPL_BYTEWISE] = true;
+            supported[IMPL_SLICE8] = true;
+#ifdef CRC32_X86
+            supported[IMPL_PCLMUL] = CpuHasPclmul();
+#endif
+            active = supported[IMPL_PCLMUL] ? IMPL_PCLMUL : IMPL_SLICE8;
+        }
+    } setup;
+
+    CRC32_t ProcessSingleBuffer(const void* data, size_t len) {
+        return impls[active](0xFFFFFFFFu, (const unsigned char*)data, len) ^ 0xFFFFFFFFu;
+    }
+
+    CRC32_t ProcessSingleBufferWith(Impl impl, const void* data, size_t len) {
+        if (!Supported(impl))
+            impl = IMPL_BYTEWISE;
+        return impls[impl](0xFFFFFFFFu, (const unsigned char*)data, len) ^ 0xFFFFFFFFu;
+    }
+
+    bool Supported(Impl impl) {
+        return impl >= 0 && impl < IMPL_COUNT && supported[impl];
+    }
+
+    Impl ActiveImpl() {
+        return active;
+    }
+
+    bool SetImpl(Impl impl) {
+        if (!Supported(impl))
+            return false;
+        active = impl;
+        return true;
+    }
+
+    const char* ImplName(Impl impl) {
+        static const char* names[IMPL_COUNT] = { "bytewise", "slice-by-8", "pclmul" };
+        return impl >= 0 && impl < IMPL_COUNT ? names[impl] : "unknown";
+    }
+}
@@ -0,0 +1,28 @@
+// CRC-32 (IEEE 802.3, reflected 0xEDB88320), bit-identical to tier1's CRC32_t / CRC32_ProcessSingleBuffer.
+// Lets the voice packet code checksum without linking tier1.
+// The implementation is picked once at startup: PCLMULQDQ folding, slice-by-8, or a byte at a time.
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+namespace CRC32 {
+    typedef uint32_t CRC32_t;
+
+    enum Impl {
+        IMPL_BYTEWISE,  // one table lookup per byte, same as tier1
+        IMPL_SLICE8,    // eight tables, 8 bytes per step
+        IMPL_PCLMUL,    // carry-less multiply folding, 64 bytes per step (x86 with PCLMULQDQ)
+        IMPL_COUNT
+    };
+
+    // Checksum of a whole buffer, init and final xor included
+    CRC32_t ProcessSingleBuffer(const void* data, size_t len);
+    // Same, with a specific implementation. For benchmarks and self checks.
+    CRC32_t ProcessSingleBufferWith(Impl impl, const void* data, size_t len);
+
+    bool Supported(Impl impl);
+    Impl ActiveImpl();
+    // Switches ProcessSingleBuffer to impl. Outputs false if the CPU doesn't support it.
+    bool SetImpl(Impl impl);
+    const char* ImplName(Impl impl);
+}
@@ -0,0 +1,46 @@
+// Opus encoder settings for one player's re-encoded stream.
+// Small enough to be copied into the player's slot and into every async job.
+#pragma once
+#include <cstdint>
+#include "opus.h"
+
+namespace SteamOpus {
+    struct EncoderProfile {
+        int32_t bitrate = OPUS_AUTO;                    // bits per second, or OPUS_AUTO
+        int16_t application = OPUS_APPLICATION_VOIP;    // OPUS_APPLICATION_VOIP, _AUDIO or _RESTRICTED_LOWDELAY
+        int16_t maxBandwidth = OPUS_BANDWIDTH_FULLBAND; // OPUS_BANDWIDTH_*
+        int8_t complexity = 10;                         // 0-10
+        bool vbr = true;
+
+        bool operator==(const EncoderProfile& o) const {
+            return bitrate == o.bitrate && application == o.application && maxBandwidth == o.maxBandwidth
+                && complexity == o.complexity && vbr == o.vbr;
+        }
+        bool operator!=(const EncoderProfile& o) const { return !(*this == o); }
+
+        // Pulls every field into the range libopus accepts
+        EncoderProfile Sanitized() const {
+            EncoderProfile p = *this;
+            if (p.bitrate <= 0) p.bitrate = OPUS_AUTO;
+            else if (p.bitrate < 500) p.bitrate = 500;
+            else if (p.bitrate > 512000) p.bitrate = 512000;
+
+            if (p.application != OPUS_APPLICATION_VOIP && p.application != OPUS_APPLICATION_AUDIO && p.application != OPUS_APPLICATION_RESTRICTED_LOWDELAY)
+                p.application = OPUS_APPLICATION_VOIP;
+
+            if (p.maxBandwidth < OPUS_BANDWIDTH_NARROWBAND || p.maxBandwidth > OPUS_BANDWIDTH_FULLBAND)
+                p.maxBandwidth = OPUS_BANDWIDTH_FULLBAND;
+
+            if (p.complexity < 0) p.complexity = 0;
+            else if (p.complexity > 10) p.complexity = 10;
+            return p;
+        }
+
+        // The same profile with complexity limited to cap
+        EncoderProfile Capped(int cap) const {
+            EncoderProfile p = *this;
+            if (p.complexity > cap) p.complexity = (int8_t)cap;
+            return p;
+        }
+    };
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "encoder_profile.h"
+
+namespace AudioEffects { struct EffectState; }
+
+class IVoiceCodec
+{
+public:
+	virtual			~IVoiceCodec() {}
+	virtual bool	Init(int quality, int sampleRate) = 0;
+	virtual int		GetSampleRate() = 0;
+	virtual void	Release() = 0;
+	virtual int		Compress(const char *pUncompressed, int nSamples, char *pCompressed, int maxCompressedBytes, bool bFinal) = 0;
+	virtual int		Decompress(const char *pCompressed, int compressedBytes, char *pUncompressed, int maxUncompressedBytes) = 0;
+	virtual bool	ResetState() = 0;
+	//Samples Compress is holding back until it has a whole frame of FrameSamples()
+	virtual int		PendingSamples() { return 0; }
+	virtual int		FrameSamples() { return 0; }
+	//Decodes the payload of a codec opcode other than the codec's own. Outputs samples or -1 if unsupported.
+	virtual int		DecompressFormat(int opcode, const char *pCompressed, int compressedBytes, char *pUncompressed, int maxUncompressedBytes) { return -1; }
+	//Float versions of Decompress and Compress, samples in [-1, 1). Sizes are in samples. Outputs -1 if unsupported.
+	virtual int		DecompressFloat(const char *pCompressed, int compressedBytes, float *pUncompressed, int maxSamples) { return -1; }
+	virtual int		CompressFloat(const float *pUncompressed, int nSamples, char *pCompressed, int maxCompressedBytes, bool bFinal) { return -1; }
+	//Encoder settings for the following Compress calls. Only the settings that changed are passed on to the encoder.
+	virtual void	SetEncoderProfile(const SteamOpus::EncoderProfile& profile) {}
+	//Follows the stream's sample rate, GetSampleRate then says what it decodes and encodes at. Outputs false if the codec can't handle it.
+	virtual bool	SetSampleRate(int sampleRate) { return sampleRate == GetSampleRate(); }
+	//What the effects remember about this stream between packets, nullptr if the codec doesn't keep it
+	virtual AudioEffects::EffectState* GetEffectState() { return nullptr; }
+};
\ No newline at end of file
@@ -0,0 +1,109 @@
+// Reorder buffer for one stream's Opus frames, keyed by their sequence number.
+// Sequence numbers wrap at 16 bits, so they are only ever compared by their distance from each other.
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include "voice_packet.h"
+
+// Most frames a stream can hold back waiting for a missing one, 320 ms of audio
+#define JITTER_MAX_DEPTH 16
+// Frames up to this far behind the stream are late or duplicates. Further back, the sender started over.
+#define JITTER_LATE_WINDOW 32
+
+namespace SteamVoice {
+    // Signed distance from b to a, right across the wrap
+    inline int SeqDiff(uint16_t a, uint16_t b) {
+        return (int16_t)(uint16_t)(a - b);
+    }
+
+    class JitterBuffer {
+    public:
+        JitterBuffer() { SetDepth(0); }
+
+        // Drops anything held. 0 still holds the frame being decoded, just never past the call.
+        void SetDepth(int frames) {
+            depth = std::min(std::max(frames, 0), JITTER_MAX_DEPTH);
+
+            slots.resize(SlotsFor(depth));
+            Clear();
+        }
+
+        // Heap a buffer of this depth holds
+        static size_t BytesFor(int frames) {
+            return SlotsFor(std::min(std::max(frames, 0), JITTER_MAX_DEPTH)) * sizeof(Slot);
+        }
+
+        int Depth() const { return depth; }
+        int Count() const { return count; }
+
+        // Copies the frame in, with the time it arrived in whatever ticks the caller uses.
+        // Outputs false if a frame with the same sequence is already held, or it doesn't fit.
+        bool Push(const OpusFrame& frame, int64_t arrival = 0) {
+            if (frame.len > OPUS_MAX_FRAME_BYTES)
+                return false;
+
+            Slot& slot = slots[frame.seq % slots.size()];
+            if (slot.used)
+                return false;
+
+            slot.used = true;
+            slot.seq = frame.seq;
+            slot.len = frame.len;
+            slot.arrival = arrival;
+            memcpy(slot.data, frame.data, frame.len);
+            count++;
+            return true;
+        }
+
+        // The held frame closest at or after from, and when it arrived. Its data stays valid until it's pushed over.
+        bool Front(uint16_t from, OpusFrame& frame, int64_t* arrival = nullptr) const {
+            const Slot* best = nullptr;
+            for (const Slot& slot : slots) {
+                if (slot.used && (best == nullptr || (uint16_t)(slot.seq - from) < (uint16_t)(best->seq - from)))
+                    best = &slot;
+            }
+            if (best == nullptr)
+                return false;
+
+            frame = OpusFrame{best->data, best->len, best->seq};
+            if (arrival != nullptr)
+                *arrival = best->arrival;
+            return true;
+        }
+
+        void Pop(uint16_t seq) {
+            Slot& slot = slots[seq % slots.size()];
+            if (slot.used && slot.seq == seq) {
+                slot.used = false;
+                count--;
+            }
+        }
+
+        void Clear() {
+            for (Slot& slot : slots) slot.used = false;
+            count = 0;
+        }
+
+    private:
+        // A power of two divides the sequence space, so seq % size stays a distinct slot across the wrap
+        static size_t SlotsFor(int depth) {
+            size_t size = 1;
+            while ((int)size < depth) size <<= 1;
+            return size;
+        }
+
+        struct Slot {
+            bool used = false;
+            uint16_t seq = 0;
+            uint16_t len = 0;
+            int64_t arrival = 0;
+            unsigned char data[OPUS_MAX_FRAME_BYTES];
+        };
+
+        std::vector<Slot> slots;
+        int depth = 0;
+        int count = 0;
+    };
+}
@@ -0,0 +1,175 @@
+#include "logger.h"
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+namespace Log {
+    struct Record {
+        std::atomic<size_t> seq;
+        Category category;
+        int nargs;
+        const char* fmt;
+        Arg args[LOG_MAX_ARGS];
+    };
+
+    // Bounded MPSC ring (Vyukov): each cell's sequence number says whether it is free for a producer or ready for the consumer
+    static Record ring[LOG_RING_SZ];
+    alignas(64) static std::atomic<size_t> enqueuePos{0};
+    alignas(64) static size_t dequeuePos = 0;
+
+    struct RateLimit {
+        std::atomic<uint32_t> perSecond{0};
+        std::atomic<int64_t> window{0};
+        std::atomic<uint32_t> used{0};
+    };
+    static RateLimit limits[CAT_COUNT];
+
+    static std::atomic<uint64_t> dropped{0};
+    static std::atomic<bool> running{false};
+    static std::thread drainThread;
+
+    static struct RingInit {
+        RingInit() {
+            for (size_t i = 0; i < LOG_RING_SZ; i++) ring[i].seq.store(i, std::memory_order_relaxed);
+            limits[CAT_WARN].perSecond = 10;
+            limits[CAT_SPEAKING].perSecond = 50;
+            limits[CAT_DEBUG].perSecond = 100;
+        }
+    } ringInit;
+
+    static bool AllowedByRateLimit(Category cat) {
+        RateLimit& rl = limits[cat];
+        uint32_t perSecond = rl.perSecond.load(std::memory_order_relaxed);
+        if (perSecond == 0) return true;
+
+        int64_t now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        int64_t window = rl.window.load(std::memory_order_relaxed);
+        if (window != now && rl.window.compare_exchange_strong(window, now, std::memory_order_relaxed)) {
+            rl.used.store(0, std::memory_order_relaxed);
+        }
+        return rl.used.fetch_add(1, std::memory_order_relaxed) < perSecond;
+    }
+
+    void WriteArgs(Category cat, const char* fmt, const Arg* args, int nargs) {
+        if (!AllowedByRateLimit(cat)) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        Record* rec;
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            rec = &ring[pos & (LOG_RING_SZ - 1)];
+            size_t seq = rec->seq.load(std::memory_order_acquire);
+            intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+            if (dif == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (dif < 0) {
+                // Full, the drain thread is behind
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        rec->category = cat;
+        rec->fmt = fmt;
+        rec->nargs = nargs;
+        std::memcpy(rec->args, args, nargs * sizeof(Arg));
+        rec->seq.store(pos + 1, std::memory_order_release);
+    }
+
+    void SetRateLimit(Category cat, uint32_t perSecond) {
+        if (cat >= 0 && cat < CAT_COUNT) limits[cat].perSecond = perSecond;
+    }
+
+    uint64_t Dropped() {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+    static void AppendArg(char*& out, char* end, const Arg& a) {
+        if (out >= end) return;
+        int n = 0;
+        switch (a.type) {
+        case Arg::INT: n = snprintf(out, end - out, "%lld", (long long)a.i); break;
+        case Arg::UINT: n = snprintf(out, end - out, "%llu", (unsigned long long)a.u); break;
+        case Arg::DOUBLE: n = snprintf(out, end - out, "%g", a.d); break;
+        case Arg::PTR: n = snprintf(out, end - out, "%p", a.p); break;
+        case Arg::STR: n = snprintf(out, end - out, "%s", a.s ? a.s : "(null)"); break;
+        }
+        if (n > 0) out += std::min<ptrdiff_t>(n, end - out - 1);
+    }
+
+    static void Format(const Record& rec, char* buf, size_t bufLen) {
+        char* out = buf;
+        char* end = buf + bufLen - 1; // room for the newline
+        int argIdx = 0;
+        for (const char* f = rec.fmt; *f && out < end - 1; f++) {
+            if (f[0] == '{' && f[1] == '}' && argIdx < rec.nargs) {
+                AppendArg(out, end, rec.args[argIdx++]);
+                f++;
+                continue;
+            }
+            *out++ = *f;
+        }
+        *out++ = '\n';
+        *out = '\0';
+    }
+
+    // Consumer side, only ever called from the drain thread (or Stop after joining it)
+    static bool DrainOne() {
+        Record* rec = &ring[dequeuePos & (LOG_RING_SZ - 1)];
+        size_t seq = rec->seq.load(std::memory_order_acquire);
+        if ((intptr_t)seq - (intptr_t)(dequeuePos + 1) != 0)
+            return false;
+
+        char line[512];
+        Format(*rec, line, sizeof(line));
+        rec->seq.store(dequeuePos + LOG_RING_SZ, std::memory_order_release);
+        dequeuePos++;
+
+        fputs(line, stdout);
+        return true;
+    }
+
+    static void DrainAll() {
+        bool wrote = false;
+        while (DrainOne()) wrote = true;
+        if (wrote) fflush(stdout);
+    }
+
+    static uint64_t reportedDrops = 0;
+
+    static void ReportDrops() {
+        uint64_t drops = Dropped();
+        if (drops != reportedDrops) {
+            fprintf(stdout, "[transcript][log] dropped %llu messages\n", (unsigned long long)(drops - reportedDrops));
+            fflush(stdout);
+            reportedDrops = drops;
+        }
+    }
+
+    static void DrainLoop() {
+        while (running.load(std::memory_order_relaxed)) {
+            DrainAll();
+            ReportDrops();
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+
+    void Start() {
+        if (running.exchange(true)) return;
+        drainThread = std::thread(DrainLoop);
+    }
+
+    void Stop() {
+        if (!running.exchange(false)) return;
+        if (drainThread.joinable()) drainThread.join();
+        DrainAll();
+        ReportDrops();
+    }
+}
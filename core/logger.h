@@ -0,0 +1,62 @@
+// Asynchronous logger safe to call from the game thread and the worker threads.
+// Write() copies the format pointer and arguments into a fixed-size lock-free ring, a background thread formats and prints them.
+// It never blocks or allocates: when the ring is full, or a category is over its rate limit, the message is dropped and counted.
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+namespace Log {
+    enum Category {
+        CAT_GENERAL,
+        CAT_WARN,
+        CAT_SPEAKING,
+        CAT_DEBUG,
+        CAT_COUNT
+    };
+
+    #define LOG_MAX_ARGS 6
+    #define LOG_RING_SZ 4096
+
+    struct Arg {
+        enum Type : uint8_t { INT, UINT, DOUBLE, PTR, STR };
+        Type type;
+        union {
+            int64_t i;
+            uint64_t u;
+            double d;
+            const void* p;
+            const char* s;  // must outlive the message, string literals only
+        };
+    };
+
+    inline Arg MakeArg(int v) { Arg a; a.type = Arg::INT; a.i = v; return a; }
+    inline Arg MakeArg(long v) { Arg a; a.type = Arg::INT; a.i = v; return a; }
+    inline Arg MakeArg(long long v) { Arg a; a.type = Arg::INT; a.i = v; return a; }
+    inline Arg MakeArg(unsigned int v) { Arg a; a.type = Arg::UINT; a.u = v; return a; }
+    inline Arg MakeArg(unsigned long v) { Arg a; a.type = Arg::UINT; a.u = v; return a; }
+    inline Arg MakeArg(unsigned long long v) { Arg a; a.type = Arg::UINT; a.u = v; return a; }
+    inline Arg MakeArg(double v) { Arg a; a.type = Arg::DOUBLE; a.d = v; return a; }
+    inline Arg MakeArg(const char* v) { Arg a; a.type = Arg::STR; a.s = v; return a; }
+    inline Arg MakeArg(const void* v) { Arg a; a.type = Arg::PTR; a.p = v; return a; }
+
+    // Queues a message. fmt is a string literal using {} placeholders.
+    void WriteArgs(Category cat, const char* fmt, const Arg* args, int nargs);
+
+    template <typename... Args>
+    void Write(Category cat, const char* fmt, Args... args) {
+        static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "too many log arguments");
+        const Arg packed[sizeof...(Args) + 1] = { MakeArg(args)... };
+        WriteArgs(cat, fmt, packed, (int)sizeof...(Args));
+    }
+
+    // Messages per second allowed for a category, 0 for unlimited
+    void SetRateLimit(Category cat, uint32_t perSecond);
+
+    // Messages lost because the ring was full or the category was over its limit
+    uint64_t Dropped();
+
+    void Start();
+    // Prints whatever is still queued and stops the background thread
+    void Stop();
+}
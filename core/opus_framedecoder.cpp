@@ -0,0 +1,530 @@
+#include "opus_framedecoder.h"
+#include "voice_packet.h"
+#include "sample_convert.h"
+#include "codec_pool.h"
+#include <cstring>
+#include <cstdlib>
+#include <atomic>
+#include <chrono>
+
+namespace SteamOpus {
+    namespace Loss {
+        static std::atomic<int> maxConcealFrames{10};
+        static std::atomic<int> jitterDepth{0};
+        static std::atomic<uint64_t> fec{0};
+        static std::atomic<uint64_t> plc{0};
+        static std::atomic<uint64_t> dropped{0};
+        static std::atomic<uint64_t> late{0};
+
+        void SetMaxConcealFrames(int frames) {
+            maxConcealFrames.store(std::max(frames, 0), std::memory_order_relaxed);
+        }
+
+        int MaxConcealFrames() {
+            return maxConcealFrames.load(std::memory_order_relaxed);
+        }
+
+        void SetJitterDepth(int frames) {
+            jitterDepth.store(std::min(std::max(frames, 0), JITTER_MAX_DEPTH), std::memory_order_relaxed);
+        }
+
+        int JitterDepth() {
+            return jitterDepth.load(std::memory_order_relaxed);
+        }
+
+        Counters Get() {
+            Counters c;
+            c.fec = fec.load(std::memory_order_relaxed);
+            c.plc = plc.load(std::memory_order_relaxed);
+            c.dropped = dropped.load(std::memory_order_relaxed);
+            c.late = late.load(std::memory_order_relaxed);
+            return c;
+        }
+
+        void Reset() {
+            fec = 0;
+            plc = 0;
+            dropped = 0;
+            late = 0;
+        }
+    }
+
+    bool PacketHasFEC(const unsigned char* data, int len) {
+        if (len <= 0)
+            return false;
+
+        // Only SILK and hybrid packets (configs 0-15) carry LBRR frames
+        if ((data[0] >> 3) >= 16)
+            return false;
+
+        const unsigned char* frames[48];
+        opus_int16 sizes[48];
+        if (opus_packet_parse(data, len, nullptr, frames, sizes, nullptr) <= 0 || sizes[0] == 0)
+            return false;
+
+        // The first bits of the first frame are its SILK VAD flags, one per 20 ms, then the LBRR flag
+        int silkFrames = std::max(opus_packet_get_samples_per_frame(data, 48000) / 960, 1);
+        bool lbrr = (frames[0][0] >> (7 - silkFrames)) & 1;
+        if (opus_packet_get_nb_channels(data) == 2)
+            lbrr = lbrr || ((frames[0][0] >> (6 - 2 * silkFrames)) & 1);
+        return lbrr;
+    }
+
+    // Decoder first, the encoder starts on the next cache line
+    static size_t DecoderBytes() {
+        return ((size_t)opus_decoder_get_size(1) + 63) & ~(size_t)63;
+    }
+
+    size_t Opus_FrameDecoder::StateSize() {
+        return DecoderBytes() + (((size_t)opus_encoder_get_size(1) + 63) & ~(size_t)63);
+    }
+
+    Opus_FrameDecoder::Opus_FrameDecoder(void* state, CodecPool* pool) : m_pool(pool) {
+        if (state == nullptr) {
+            state = malloc(StateSize());
+            m_ownsState = true;
+        }
+        dec = (OpusDecoder*)state;
+        enc = (OpusEncoder*)((char*)state + DecoderBytes());
+        InitCodecs();
+    }
+
+    void Opus_FrameDecoder::InitCodecs() {
+        // Same memory at any rate, so switching rates never allocates
+        opus_decoder_init(dec, m_rate, 1);
+        opus_encoder_init(enc, m_rate, 1, profile.application);
+
+        // Don't depend on whatever defaults this libopus has
+        opus_encoder_ctl(enc, OPUS_SET_MAX_BANDWIDTH(profile.maxBandwidth));
+        opus_encoder_ctl(enc, OPUS_SET_COMPLEXITY(profile.complexity));
+        opus_encoder_ctl(enc, OPUS_SET_VBR(profile.vbr ? 1 : 0));
+
+        // A fresh encoder has none of what AdaptToLoss set on the old one
+        m_lossPerc = -1;
+        m_fec = false;
+        m_bitrate = 0;
+        AdaptToLoss();
+    }
+
+    Opus_FrameDecoder::~Opus_FrameDecoder() {
+        if (m_ownsState)
+            free(dec);
+    }
+
+    bool Opus_FrameDecoder::Init(int quality, int sampleRate) {
+        return SetSampleRate(sampleRate);
+    }
+
+    int Opus_FrameDecoder::GetSampleRate() {
+        return m_rate;
+    }
+
+    bool Opus_FrameDecoder::SetSampleRate(int sampleRate) {
+        if (sampleRate == m_streamRate)
+            return true;
+        if (sampleRate <= 0)
+            return false;
+
+        // The rates libopus runs at. Anything else is decoded at the next one up, only raw PCM needs resampling to it.
+        static const int opusRates[] = { 8000, 12000, 16000, 24000, 48000 };
+        int rate = 48000;
+        for (int r : opusRates) {
+            if (r >= sampleRate) {
+                rate = r;
+                break;
+            }
+        }
+        m_streamRate = sampleRate;
+        formats.SetSampleRate(m_streamRate, rate);
+        if (rate == m_rate)
+            return true;
+
+        // Both sides start over, nothing buffered at the old rate is any use at the new one
+        m_rate = rate;
+        m_frameSize = rate / 50;
+        InitCodecs();
+
+        m_seq = 0;
+        m_encodeSeq = 0;
+        m_inStream = false;
+        pending_count = 0;
+        jitter.Clear();
+        effects.Reset();
+        return true;
+    }
+
+    bool Opus_FrameDecoder::ResetState() {
+        opus_decoder_ctl(dec, OPUS_RESET_STATE);
+        opus_encoder_ctl(enc, OPUS_RESET_STATE);
+        m_seq = 0;
+        m_encodeSeq = 0;
+        m_inStream = false;
+        m_loss = 0.0f;
+        pending_count = 0;
+        jitter.Clear();
+        formats.Reset();
+        effects.Reset();
+        return true;
+    }
+
+    void Opus_FrameDecoder::Release() {
+        // A codec waiting in the pool holds nothing beyond its own state, the other formats' decoders
+        // are only created again if its next player sends them
+        formats.Clear();
+        if (m_pool != nullptr)
+            m_pool->Return(this);
+        else
+            delete this;
+    }
+
+    void Opus_FrameDecoder::SetEncoderProfile(const EncoderProfile& next) {
+        if (next == profile)
+            return;
+
+        if (next.application != profile.application) {
+            // libopus only takes a new application before the first frame of a stream
+            if (opus_encoder_ctl(enc, OPUS_SET_APPLICATION(next.application)) != OPUS_OK) {
+                opus_encoder_ctl(enc, OPUS_RESET_STATE);
+                opus_encoder_ctl(enc, OPUS_SET_APPLICATION(next.application));
+            }
+        }
+        if (next.maxBandwidth != profile.maxBandwidth)
+            opus_encoder_ctl(enc, OPUS_SET_MAX_BANDWIDTH(next.maxBandwidth));
+        if (next.complexity != profile.complexity)
+            opus_encoder_ctl(enc, OPUS_SET_COMPLEXITY(next.complexity));
+        if (next.vbr != profile.vbr)
+            opus_encoder_ctl(enc, OPUS_SET_VBR(next.vbr ? 1 : 0));
+
+        profile = next;
+        // Picks up the bitrate
+        AdaptToLoss();
+    }
+
+    void Opus_FrameDecoder::TrackLoss(int lost) {
+        // Exponential average over about 50 frames, one second of audio.
+        // A long gap is as likely a stall as loss, so it counts as no more than 10 frames.
+        const float alpha = 1.0f / 50.0f;
+        lost = std::min(lost, 10);
+        for (int i = 0; i < lost; i++)
+            m_loss += alpha * (1.0f - m_loss);
+        m_loss -= alpha * m_loss;
+    }
+
+    void Opus_FrameDecoder::AdaptToLoss() {
+        int lossPerc = (int)(m_loss * 100.0f + 0.5f);
+        bool fec = lossPerc >= (m_fec ? ADAPTIVE_FEC_ON_PERC / 2 : ADAPTIVE_FEC_ON_PERC);
+
+        int bitrate = profile.bitrate;
+        if (bitrate == OPUS_AUTO) {
+            int perc = std::min(lossPerc, ADAPTIVE_LOSS_FULL_PERC);
+            bitrate = ADAPTIVE_BITRATE_MIN + (ADAPTIVE_BITRATE_MAX - ADAPTIVE_BITRATE_MIN) * perc / ADAPTIVE_LOSS_FULL_PERC;
+        }
+
+        if (lossPerc != m_lossPerc) {
+            opus_encoder_ctl(enc, OPUS_SET_PACKET_LOSS_PERC(lossPerc));
+            m_lossPerc = lossPerc;
+        }
+        if (fec != m_fec) {
+            opus_encoder_ctl(enc, OPUS_SET_INBAND_FEC(fec ? 1 : 0));
+            m_fec = fec;
+        }
+        if (bitrate != m_bitrate) {
+            opus_encoder_ctl(enc, OPUS_SET_BITRATE(bitrate));
+            m_bitrate = bitrate;
+        }
+    }
+
+    // The two sample types share everything but the libopus calls and how samples reach the pending frame
+    static int EncodeOpus(OpusEncoder* enc, const int16_t* pcm, int frameSize, unsigned char* out, int maxOut) {
+        return opus_encode(enc, pcm, frameSize, out, maxOut);
+    }
+
+    static int EncodeOpus(OpusEncoder* enc, const float* pcm, int frameSize, unsigned char* out, int maxOut) {
+        return opus_encode_float(enc, pcm, frameSize, out, maxOut);
+    }
+
+    static int DecodeOpus(OpusDecoder* dec, const unsigned char* data, int len, int16_t* pcm, int frameSize, int fec) {
+        return opus_decode(dec, data, len, pcm, frameSize, fec);
+    }
+
+    static int DecodeOpus(OpusDecoder* dec, const unsigned char* data, int len, float* pcm, int frameSize, int fec) {
+        return opus_decode_float(dec, data, len, pcm, frameSize, fec);
+    }
+
+    static void CopyToPending(const int16_t* in, float* out, int samples) {
+        SampleConvert::ToFloat(in, out, samples);
+    }
+
+    static void CopyToPending(const float* in, float* out, int samples) {
+        memcpy(out, in, samples * sizeof(float));
+    }
+
+    template <typename T>
+    static int EncodeFrameWith(OpusEncoder* enc, int frameSize, uint16_t seq, const T* frame, char*& pCompressed, char* pCompressedEnd) {
+        // [len][seq][opus], the length is filled in once we know it
+        if (pCompressed + 2 * sizeof(uint16_t) > pCompressedEnd)
+            return -1;
+
+        char* chunk_len = pCompressed;
+        pCompressed += sizeof(uint16_t);
+        memcpy(pCompressed, &seq, sizeof(seq));
+        pCompressed += sizeof(uint16_t);
+
+        int bytes_written = EncodeOpus(enc, frame, frameSize, (unsigned char*)pCompressed, std::min<int64_t>(OPUS_MAX_FRAME_BYTES, pCompressedEnd - pCompressed));
+        if (bytes_written < 0)
+            return -1;
+
+        uint16_t len = (uint16_t)bytes_written;
+        memcpy(chunk_len, &len, sizeof(len));
+        pCompressed += bytes_written;
+        return bytes_written;
+    }
+
+    int Opus_FrameDecoder::EncodeFrame(const int16_t* frame, char*& pCompressed, char* pCompressedEnd) {
+        return EncodeFrameWith(enc, m_frameSize, m_encodeSeq++, frame, pCompressed, pCompressedEnd);
+    }
+
+    int Opus_FrameDecoder::EncodeFrame(const float* frame, char*& pCompressed, char* pCompressedEnd) {
+        return EncodeFrameWith(enc, m_frameSize, m_encodeSeq++, frame, pCompressed, pCompressedEnd);
+    }
+
+    template <typename T>
+    int Opus_FrameDecoder::CompressFrames(const T* in, int nSamples, char* pCompressed, int maxCompressedBytes, bool bFinal) {
+        if (!nSamples) return 0;
+
+        AdaptToLoss();
+
+        const char* const pCompressedBase = pCompressed;
+        char* pCompressedEnd = pCompressed + maxCompressedBytes;
+        int left = nSamples;
+
+        // Complete the frame left over from the last call first
+        if (pending_count > 0) {
+            int take = std::min(left, m_frameSize - pending_count);
+            CopyToPending(in, pending + pending_count, take);
+            pending_count += take;
+            in += take;
+            left -= take;
+
+            if (pending_count < m_frameSize) {
+                if (!bFinal)
+                    return 0;
+
+                // if bFinal do not keep it back and fill instead
+                memset(pending + pending_count, 0, (m_frameSize - pending_count) * sizeof(float));
+            }
+
+            pending_count = 0;
+            if (EncodeFrame(pending, pCompressed, pCompressedEnd) < 0)
+                return -1;
+        }
+
+        // Whole frames straight out of the caller's buffer
+        while (left >= m_frameSize) {
+            if (EncodeFrame(in, pCompressed, pCompressedEnd) < 0)
+                return -1;
+
+            in += m_frameSize;
+            left -= m_frameSize;
+        }
+
+        // Keep the remainder for next time, or pad it out on the last call
+        if (left > 0) {
+            CopyToPending(in, pending, left);
+            pending_count = left;
+
+            if (bFinal) {
+                memset(pending + left, 0, (m_frameSize - left) * sizeof(float));
+                pending_count = 0;
+                if (EncodeFrame(pending, pCompressed, pCompressedEnd) < 0)
+                    return -1;
+            }
+        }
+
+        if (bFinal) {
+            opus_encoder_ctl(enc, OPUS_RESET_STATE);
+            m_encodeSeq = 0;
+            if (pCompressed + sizeof(uint16_t) > pCompressedEnd)
+                return -1;
+
+            memcpy(pCompressed, &SteamVoice::OPUS_END_OF_STREAM, sizeof(uint16_t));
+            pCompressed += sizeof(uint16_t);
+        }
+
+        return pCompressed - pCompressedBase;
+    }
+
+    int Opus_FrameDecoder::Compress(const char* pUncompressed, int nSamples, char* pCompressed, int maxCompressedBytes, bool bFinal) {
+        return CompressFrames((const int16_t*)pUncompressed, nSamples, pCompressed, maxCompressedBytes, bFinal);
+    }
+
+    int Opus_FrameDecoder::CompressFloat(const float* pUncompressed, int nSamples, char* pCompressed, int maxCompressedBytes, bool bFinal) {
+        return CompressFrames(pUncompressed, nSamples, pCompressed, maxCompressedBytes, bFinal);
+    }
+
+    template <typename T>
+    int Opus_FrameDecoder::ConcealGap(int lost, const SteamVoice::OpusFrame& frame, T* pcm, int maxSamples) {
+        int conceal = std::min(lost, Loss::MaxConcealFrames());
+        int written = 0;
+
+        // FEC in this frame can only rebuild the one right before it, everything older gets PLC
+        bool fec = conceal > 0 && PacketHasFEC(frame.data, frame.len);
+        int plcFrames = fec ? conceal - 1 : conceal;
+        int filled = 0;
+
+        for (int i = 0; i < plcFrames && maxSamples - written >= m_frameSize; i++) {
+            int samples = DecodeOpus(dec, nullptr, 0, pcm + written, m_frameSize, 0);
+            if (samples < 0)
+                break;
+
+            written += samples;
+            filled++;
+            Loss::plc.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // Only worth it if every older frame made it in, otherwise the recovered audio would land in the wrong place
+        if (fec && filled == plcFrames && maxSamples - written >= m_frameSize) {
+            int samples = DecodeOpus(dec, frame.data, frame.len, pcm + written, m_frameSize, 1);
+            if (samples > 0) {
+                written += samples;
+                filled++;
+                Loss::fec.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        Loss::dropped.fetch_add(lost - filled, std::memory_order_relaxed);
+        return written;
+    }
+
+    // How long a held frame may wait for the ones missing before it, in steady_clock ticks. A frame per step of the depth.
+    static int64_t HeldDeadline(int depth) {
+        return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::milliseconds(20 * depth)).count();
+    }
+
+    template <typename T>
+    int Opus_FrameDecoder::ReleaseFrames(uint16_t newest, bool flush, int64_t now, T* pcm, int maxSamples) {
+        int written = 0;
+
+        SteamVoice::OpusFrame frame;
+        int64_t arrival;
+        while (jitter.Front(m_seq, frame, &arrival)) {
+            int lost = SteamVoice::SeqDiff(frame.seq, m_seq);
+            if (lost > 0) {
+                // The missing frame still has time to turn up
+                if (!flush && SteamVoice::SeqDiff(newest, m_seq) < jitter.Depth() && now - arrival < HeldDeadline(jitter.Depth()))
+                    break;
+
+                written += ConcealGap(lost, frame, pcm + written, maxSamples - written);
+            }
+            TrackLoss(lost);
+            m_seq = frame.seq + 1;
+
+            int samples = DecodeOpus(dec, frame.data, frame.len, pcm + written, maxSamples - written, 0);
+            jitter.Pop(frame.seq);
+            if (samples < 0)
+                return -1;
+
+            written += samples;
+        }
+
+        return written;
+    }
+
+    template <typename T>
+    int Opus_FrameDecoder::DecompressFrames(const char* pCompressed, int compressedBytes, T* pcm, int maxSamples) {
+        int written = 0;
+        int released;
+        const int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
+
+        // Whatever is held goes out before the depth changes under it
+        int depth = Loss::JitterDepth();
+        if (depth != jitter.Depth()) {
+            if ((released = ReleaseFrames(m_seq, true, now, pcm, maxSamples)) < 0)
+                return -1;
+
+            written += released;
+            jitter.SetDepth(depth);
+        }
+
+        SteamVoice::OpusFrameIterator frames(pCompressed, (uint16_t)compressedBytes);
+        SteamVoice::OpusFrame frame;
+        while (frames.Next(frame)) {
+            if (frame.EndOfStream()) {
+                // Nothing else is coming to fill the gaps
+                if ((released = ReleaseFrames(m_seq, true, now, pcm + written, maxSamples - written)) < 0)
+                    return -1;
+
+                written += released;
+                opus_decoder_ctl(dec, OPUS_RESET_STATE);
+                m_seq = 0;
+                m_inStream = false;
+                continue;
+            }
+
+            if (frame.len > OPUS_MAX_FRAME_BYTES)
+                return -1;
+
+            if (!m_inStream) {
+                // Joined a stream part way through, or a new one started
+                m_inStream = true;
+                m_seq = frame.seq;
+            }
+
+            int ahead = SteamVoice::SeqDiff(frame.seq, m_seq);
+            if (ahead < -JITTER_LATE_WINDOW) {
+                // Too far back to be late, the sender started over without ending the stream
+                if ((released = ReleaseFrames(m_seq, true, now, pcm + written, maxSamples - written)) < 0)
+                    return -1;
+
+                written += released;
+                opus_decoder_ctl(dec, OPUS_RESET_STATE);
+                m_seq = frame.seq;
+            }
+            else if (ahead < 0) {
+                // Its place in the stream was already decoded or concealed
+                Loss::late.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+
+            // Frames that can't wait for anything past this one go first, which also frees its slot
+            if ((released = ReleaseFrames(frame.seq, false, now, pcm + written, maxSamples - written)) < 0)
+                return -1;
+
+            written += released;
+            if (!jitter.Push(frame, now)) {
+                Loss::late.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+
+            if ((released = ReleaseFrames(frame.seq, false, now, pcm + written, maxSamples - written)) < 0)
+                return -1;
+
+            written += released;
+        }
+
+        if (frames.Corrupt())
+            return -1;
+
+        // Frames that have waited out their deadline go whether anything newer arrived or not.
+        // A payload without any frames says the sender has been quiet for longer than that, so everything goes.
+        if ((released = ReleaseFrames(m_seq, compressedBytes == 0, now, pcm + written, maxSamples - written)) < 0)
+            return -1;
+
+        written += released;
+
+        // Return number of samples written to pcm
+        return written;
+    }
+
+    int Opus_FrameDecoder::Decompress(const char* pCompressed, int compressedBytes, char* pUncompressed, int maxUncompressedBytes) {
+        return DecompressFrames(pCompressed, compressedBytes, (opus_int16*)pUncompressed, maxUncompressedBytes / 2);
+    }
+
+    int Opus_FrameDecoder::DecompressFloat(const char* pCompressed, int compressedBytes, float* pUncompressed, int maxSamples) {
+        return DecompressFrames(pCompressed, compressedBytes, pUncompressed, maxSamples);
+    }
+
+    int Opus_FrameDecoder::DecompressFormat(int opcode, const char* pCompressed, int compressedBytes, char* pUncompressed, int maxUncompressedBytes) {
+        return formats.Decode(opcode, pCompressed, compressedBytes, (int16_t*)pUncompressed, maxUncompressedBytes / 2);
+    }
+}
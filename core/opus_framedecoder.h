@@ -0,0 +1,162 @@
+#pragma once
+#include "opus.h"
+#include "ivoicecodec.h"
+#include "voice_formats.h"
+#include "voice_packet.h"
+#include "jitter_buffer.h"
+#include "audio_effects.h"
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+
+namespace SteamOpus {
+
+    #define SAMPLERATE_GMOD_OPUS 24000
+    #define FRAME_SIZE_GMOD 480
+    // One 20 ms frame at 48 kHz, the highest rate libopus runs at
+    #define OPUS_MAX_FRAME_SAMPLES 960
+
+    // Bitrate range for profiles on OPUS_AUTO. Clean streams get the low end, the bitrate climbs with
+    // the sender's loss so in-band FEC has room, up to the high end at LOSS_FULL_PERC.
+    #define ADAPTIVE_BITRATE_MIN 20000
+    #define ADAPTIVE_BITRATE_MAX 32000
+    #define ADAPTIVE_LOSS_FULL_PERC 20
+    // In-band FEC goes on at this much loss and back off below half of it
+    #define ADAPTIVE_FEC_ON_PERC 2
+
+    #define CHK_BUF_ACCESS(varName, start, end, type)  \
+        if(start + sizeof(type) > end) \
+            return -1;                 \
+        type varName = *(type*)start;\
+        start += sizeof(type);
+
+    #define CHK_BUF_WRITE(start, end, type, val) \
+        if(start + sizeof(type) > end) \
+            return -1;                  \
+        *(type*)start = val;            \
+        start += sizeof(type);
+
+    enum opcodes {
+        OP_CODEC_OPUSPLC = 6,
+        OP_SAMPLERATE = 11,
+        OP_SILENCE = 0
+    };
+
+    // Packet loss handling shared by every Opus_FrameDecoder
+    namespace Loss {
+        // Frames of a sequence gap that get recovered or concealed, the rest of the gap is dropped. Defaults to 10.
+        void SetMaxConcealFrames(int frames);
+        int MaxConcealFrames();
+        // Frames a stream may hold back waiting for a missing one to arrive out of order, up to JITTER_MAX_DEPTH.
+        // Defaults to 0, where a missing frame is given up on as soon as a later one arrives.
+        void SetJitterDepth(int frames);
+        int JitterDepth();
+
+        // Lost frames recovered from in-band FEC, concealed with PLC, and not filled in at all
+        struct Counters {
+            uint64_t fec = 0;
+            uint64_t plc = 0;
+            uint64_t dropped = 0;
+            // Frames that turned up after they'd been given up on, or twice
+            uint64_t late = 0;
+        };
+        Counters Get();
+        void Reset();
+    }
+
+    // True if the Opus packet carries in-band FEC (LBRR) data for the frame before it
+    bool PacketHasFEC(const unsigned char* data, int len);
+
+    class CodecPool;
+
+    class Opus_FrameDecoder : public IVoiceCodec {
+    private:
+        Opus_FrameDecoder(const Opus_FrameDecoder&) {}
+        Opus_FrameDecoder& operator=(const Opus_FrameDecoder&) = delete;
+
+    public:
+        // state is StateSize() bytes for the decoder and encoder, allocated here if null.
+        // Release() hands the codec back to pool, or deletes it without one.
+        explicit Opus_FrameDecoder(void* state = nullptr, CodecPool* pool = nullptr);
+        virtual ~Opus_FrameDecoder();
+
+        static size_t StateSize();
+
+        virtual bool Init(int quality, int sampleRate);
+        virtual int	GetSampleRate();
+        virtual bool ResetState();
+        virtual void Release();
+        virtual int	Compress(const char* pUncompressed, int nSamples, char* pCompressed, int maxCompressedBytes, bool bFinal);
+        // An empty payload lets go of every frame held back, for a sender that has fallen quiet
+        virtual int	Decompress(const char* pCompressed, int compressedBytes, char* pUncompressed, int maxUncompressedBytes);
+        virtual int PendingSamples() { return pending_count; }
+        virtual int FrameSamples() { return m_frameSize; }
+        virtual int DecompressFormat(int opcode, const char* pCompressed, int compressedBytes, char* pUncompressed, int maxUncompressedBytes);
+        virtual int DecompressFloat(const char* pCompressed, int compressedBytes, float* pUncompressed, int maxSamples);
+        virtual int CompressFloat(const float* pUncompressed, int nSamples, char* pCompressed, int maxCompressedBytes, bool bFinal);
+        virtual void SetEncoderProfile(const EncoderProfile& profile);
+        // Follows the stream's rate. Both Opus sides run at the lowest of 8, 12, 16, 24 or 48 kHz that isn't below it,
+        // which GetSampleRate outputs and every format decodes to. Anything mid stream is dropped when that changes.
+        virtual bool SetSampleRate(int sampleRate);
+        virtual AudioEffects::EffectState* GetEffectState() { return &effects; }
+        // Share of this sender's frames that went missing, averaged over roughly the last second
+        float LossRate() const { return m_loss; }
+
+    private:
+        // Sets dec and enc up at m_rate, with the current profile
+        void InitCodecs();
+        // Writes one [len][seq][opus] frame and advances pCompressed. Outputs the Opus bytes or -1.
+        int EncodeFrame(const int16_t* frame, char*& pCompressed, char* pCompressedEnd);
+        int EncodeFrame(const float* frame, char*& pCompressed, char* pCompressedEnd);
+        // Compress and Decompress for either sample type. Defined in the .cpp, only used there.
+        template <typename T>
+        int CompressFrames(const T* in, int nSamples, char* pCompressed, int maxCompressedBytes, bool bFinal);
+        template <typename T>
+        int DecompressFrames(const char* pCompressed, int compressedBytes, T* pcm, int maxSamples);
+        // Decodes the held frames that are next in line. A missing frame is given up on once a frame the jitter
+        // depth past it has arrived, once the frame after it has been held for the jitter depth's worth of audio
+        // (now is in steady_clock ticks), or straight away when flushing. Outputs the samples written or -1.
+        template <typename T>
+        int ReleaseFrames(uint16_t newest, bool flush, int64_t now, T* pcm, int maxSamples);
+        // Fills in the lost frames before frame. Outputs the samples written.
+        template <typename T>
+        int ConcealGap(int lost, const SteamVoice::OpusFrame& frame, T* pcm, int maxSamples);
+        // Folds a received frame, and the lost frames before it, into m_loss
+        void TrackLoss(int lost);
+        // Sets packet loss, FEC and bitrate on enc from m_loss and the profile, if they changed
+        void AdaptToLoss();
+
+        int m_rate = SAMPLERATE_GMOD_OPUS;
+        // What the stream's OP_SAMPLERATE says, the rate raw PCM arrives at
+        int m_streamRate = SAMPLERATE_GMOD_OPUS;
+        // Samples in a 20 ms frame at m_rate
+        int m_frameSize = FRAME_SIZE_GMOD;
+        // Next frame to decode
+        uint16_t m_seq = 0;
+        uint16_t m_encodeSeq = 0;
+        // Off until the first frame of a stream, which has nothing before it to count as lost
+        bool m_inStream = false;
+        float m_loss = 0.0f;
+        // What AdaptToLoss last set on enc
+        int m_lossPerc = -1;
+        bool m_fec = false;
+        int m_bitrate = 0;
+        // Both live in one block, from the pool or our own
+        OpusDecoder* dec = nullptr;
+        OpusEncoder* enc = nullptr;
+        bool m_ownsState = false;
+        CodecPool* m_pool = nullptr;
+        // What enc is currently set to
+        EncoderProfile profile;
+        // Samples short of a whole frame, carried over to the next Compress call.
+        // Float so Compress and CompressFloat calls can be mixed.
+        float pending[OPUS_MAX_FRAME_SAMPLES];
+        int pending_count = 0;
+        // Frames that arrived ahead of a missing one
+        SteamVoice::JitterBuffer jitter;
+        // Decoders for whatever other formats the player sends, the output is always encoded with enc
+        SteamVoice::FormatDecoders formats;
+        // Effect memory of this player's stream, starts over with it
+        AudioEffects::EffectState effects;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,243 @@
+#include "recorder.h"
+// Use bundled opus headers (located in opus/include). Premake already adds that include dir, so just include <opus.h>.
+#include <opus.h>
+#include <cstdio>
+#include <ctime>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+// Enough for a 20ms frame at 48000Hz
+static const int16_t zeros[960] = {};
+
+RecorderManager::RecorderManager() {
+    worker = std::thread(&RecorderManager::Worker, this);
+}
+
+RecorderManager::~RecorderManager() {
+    running = false;
+    cv.notify_all();
+    if (worker.joinable()) worker.join();
+    // cleanup sessions
+    for (auto &p : sessions) {
+        CloseSession(p.second);
+    }
+}
+
+void RecorderManager::CloseSession(RecordingSession& session) {
+    if (session.stream) {
+        streamBytes -= StreamBytes(*session.stream);
+        // The last partial frame would otherwise be lost, pad it out with silence
+        if (session.encoder && session.file && !session.stream->carry.empty()) {
+            const size_t frameSamples = session.sampleRate / 50;
+            EncodeFrames(session, zeros, frameSamples - session.stream->carry.size());
+        }
+    }
+    encoders.Release(session.encoder);
+    if (session.file) fclose(session.file);
+    delete session.stream;
+}
+
+size_t RecorderManager::TaskBytes(const RecordingTask& task) {
+    return sizeof(RecordingTask) + task.pcm.capacity() * sizeof(int16_t) + task.opus.capacity();
+}
+
+size_t RecorderManager::StreamBytes(const RecordingStream& stream) {
+    return sizeof(RecordingStream) + stream.resampler.Bytes() + (stream.resampled.capacity() + stream.carry.capacity()) * sizeof(int16_t) + stream.packet.capacity();
+}
+
+void RecorderManager::Push(RecordingTask&& task) {
+    queueBytes += TaskBytes(task);
+    tasks.push(std::move(task));
+    cv.notify_one();
+}
+
+RecorderMemory RecorderManager::Memory() {
+    RecorderMemory mem;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        mem.queuedTasks = tasks.size();
+        mem.sessions = sessions.size();
+    }
+    mem.queueBytes = queueBytes.load();
+    mem.sessionBytes = streamBytes.load() + encoders.Bytes();
+    return mem;
+}
+
+void RecorderManager::Start(int uid, int sampleRate) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (sessions.find(uid) != sessions.end()) return; // already
+    }
+
+    // Take an encoder and open the file without holding the lock, so submitters never wait on disk I/O
+    OpusEncoder* enc = encoders.Acquire(sampleRate, OPUS_APPLICATION_AUDIO);
+    if (!enc) return; // failed
+    opus_encoder_ctl(enc, OPUS_SET_BITRATE(32000));
+
+    std::string fname = MakeFilename(uid);
+    FILE* f = fopen(fname.c_str(), "wb");
+    if (!f) {
+        encoders.Release(enc);
+        return;
+    }
+    // Simple header: magic + version
+    const char magic[8] = {'O','P','U','S','P','K','T','1'};
+    fwrite(magic, 1, sizeof(magic), f);
+    fflush(f);
+
+    RecordingSession session{enc, f, sampleRate, new RecordingStream()};
+    streamBytes += StreamBytes(*session.stream);
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!sessions.emplace(uid, session).second) {
+        // Lost a race with another Start for the same uid
+        CloseSession(session);
+    }
+}
+
+void RecorderManager::SubmitPCM(int uid, const int16_t* samples, size_t count, int sampleRate) {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = sessions.find(uid);
+    if (it == sessions.end()) return; // not recording
+    RecordingTask t; t.uid = uid; t.sampleRate = sampleRate; t.session = it->second; t.pcm.assign(samples, samples + count);
+    Push(std::move(t));
+}
+
+void RecorderManager::SubmitSilence(int uid, size_t count, int sampleRate) {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = sessions.find(uid);
+    if (it == sessions.end()) return; // not recording
+    RecordingTask t; t.uid = uid; t.sampleRate = sampleRate; t.session = it->second; t.silence = count;
+    Push(std::move(t));
+}
+
+void RecorderManager::SubmitOpusPacket(int uid, const unsigned char* data, size_t len) {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = sessions.find(uid);
+    if (it == sessions.end()) return; // not recording
+    RecordingTask t; t.uid = uid; t.sampleRate = 0; t.session = it->second; t.opus.assign(data, data + len);
+    Push(std::move(t));
+}
+
+void RecorderManager::WriteOpusPacket(RecordingSession& session, const unsigned char* data, size_t len) {
+    if (!session.file || len == 0) return;
+    // Direct write (length prefix + data)
+    uint16_t sz = (uint16_t)len;
+    fwrite(&sz, sizeof(uint16_t), 1, session.file);
+    fwrite(data, 1, len, session.file);
+    fflush(session.file);
+}
+
+void RecorderManager::Stop(int uid) {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = sessions.find(uid);
+    if (it == sessions.end()) return;
+    // Tasks queued before this one still carry the session, the worker closes it once they're written.
+    // A new Start for the uid gets a session of its own in the meantime.
+    RecordingTask t; t.uid = uid; t.sampleRate = 0; t.close = true; t.session = it->second;
+    sessions.erase(it);
+    Push(std::move(t));
+}
+
+void RecorderManager::Worker() {
+    for (;;) {
+        RecordingTask task;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait(lock, [&]{ return !running || !tasks.empty(); });
+            if (!running && tasks.empty()) break;
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+        queueBytes -= TaskBytes(task);
+        if (task.close) {
+            CloseSession(task.session);
+            continue;
+        }
+        // The session the task was submitted to, only closed after every task queued for it
+        RecordingSession& session = task.session;
+        size_t before = session.stream ? StreamBytes(*session.stream) : 0;
+        if (!task.opus.empty()) {
+            WriteOpusPacket(session, task.opus.data(), task.opus.size());
+        } else if (task.silence) {
+            EncodeSilence(session, task.silence, task.sampleRate);
+        } else {
+            EncodeAndWrite(session, task.pcm.data(), task.pcm.size(), task.sampleRate);
+        }
+        if (session.stream) streamBytes += StreamBytes(*session.stream) - before;
+    }
+}
+
+void RecorderManager::EncodeAndWrite(RecordingSession& session, const int16_t* samples, size_t count, int sampleRate) {
+    if (!session.encoder || !session.file || !session.stream || count == 0) return;
+    RecordingStream& stream = *session.stream;
+
+    // Once here on the worker, however many places the recording is read from later
+    if (sampleRate != session.sampleRate) {
+        if (!stream.resampler.Configure(sampleRate, session.sampleRate)) return;
+        stream.resampled.resize(stream.resampler.MaxOutput((int)count));
+        int resampled = stream.resampler.Process(samples, (int)count, stream.resampled.data(), (int)stream.resampled.size());
+        if (resampled <= 0) return;
+        samples = stream.resampled.data();
+        count = resampled;
+    }
+    EncodeFrames(session, samples, count);
+}
+
+void RecorderManager::EncodeFrames(RecordingSession& session, const int16_t* samples, size_t count) {
+    RecordingStream& stream = *session.stream;
+    // Encode in fixed frames (e.g., 20ms). 20ms at 24000Hz = 480 samples.
+    const size_t frameSamples = session.sampleRate / 50;
+    stream.packet.resize(4000);
+
+    auto encode = [&](const int16_t* frame) {
+        int encoded = opus_encode(session.encoder, frame, (int)frameSamples, stream.packet.data(), (opus_int32)stream.packet.size());
+        if (encoded > 0) {
+            WriteOpusPacket(session, stream.packet.data(), encoded);
+        }
+    };
+
+    // Complete the frame left over from the last submission first
+    size_t offset = 0;
+    if (!stream.carry.empty()) {
+        offset = std::min(frameSamples - stream.carry.size(), count);
+        stream.carry.insert(stream.carry.end(), samples, samples + offset);
+        if (stream.carry.size() < frameSamples) return;
+        encode(stream.carry.data());
+        stream.carry.clear();
+    }
+
+    while (offset + frameSamples <= count) {
+        encode(samples + offset);
+        offset += frameSamples;
+    }
+    stream.carry.assign(samples + offset, samples + count);
+}
+
+void RecorderManager::EncodeSilence(RecordingSession& session, size_t count, int sampleRate) {
+    // The file has no silence marker, so the gap is encoded like any other audio.
+    // Zeros need no resampling, only the count is converted to the session's rate.
+    if (!session.encoder || !session.file || !session.stream || sampleRate <= 0) return;
+    count = (size_t)((uint64_t)count * session.sampleRate / sampleRate);
+
+    const size_t frameSamples = session.sampleRate / 50;
+    for (size_t left = count; left > 0; ) {
+        size_t chunk = std::min(left, frameSamples);
+        EncodeFrames(session, zeros, chunk);
+        left -= chunk;
+    }
+}
+
+std::string RecorderManager::MakeFilename(int uid) const {
+    auto t = std::time(nullptr);
+    std::tm tm;
+#if defined(_WIN32)
+    localtime_s(&tm, &t);
+#else
+    localtime_r(&t, &tm);
+#endif
+    std::ostringstream oss;
+    oss << "recording_" << uid << "_"
+        << std::put_time(&tm, "%Y%m%d_%H%M%S") << ".opuspkt"; // custom container (length-prefixed packets)
+    return oss.str();
+}
@@ -0,0 +1,99 @@
+// Asynchronous per-player voice recorder encoding PCM to Opus packets (length-prefixed) in a background thread.
+#pragma once
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <queue>
+#include <atomic>
+#include <cstdint>
+#include "resampler.h"
+#include "codec_pool.h"
+
+struct OpusEncoder; // forward (we will create dynamically via opus headers already present)
+
+// Worker-only state carried between the tasks of one recording
+struct RecordingStream {
+    // Converts submissions at another rate to the session's
+    Resampler resampler;
+    std::vector<int16_t> resampled;
+    // Samples short of a whole frame, encoded with the next submission
+    std::vector<int16_t> carry;
+    std::vector<unsigned char> packet;
+};
+
+struct RecordingSession {
+    OpusEncoder* encoder = nullptr;
+    FILE* file = nullptr;
+    // Rate the file is encoded at, whatever rate the audio is submitted at
+    int sampleRate = 0;
+    // Sessions are copied around by value, this is shared and freed by CloseSession
+    RecordingStream* stream = nullptr;
+};
+
+struct RecordingTask {
+    int uid;
+    std::vector<int16_t> pcm; // mono 16-bit samples
+    std::vector<unsigned char> opus; // already encoded frame, written as is when pcm is empty
+    size_t silence = 0; // samples of silence, only expanded to PCM on the worker
+    int sampleRate;
+    // Set by Stop: the worker closes the session once the tasks queued before it are written
+    bool close = false;
+    // Taken when the task is submitted, so it's written to that session even if the uid has been stopped or restarted since
+    RecordingSession session;
+};
+
+// Heap the recorder holds right now
+struct RecorderMemory {
+    size_t queuedTasks = 0;
+    // Tasks waiting for the worker, with their samples
+    size_t queueBytes = 0;
+    size_t sessions = 0;
+    // Every session's worker buffers, plus the encoder pool
+    size_t sessionBytes = 0;
+};
+
+class RecorderManager {
+public:
+    RecorderManager();
+    ~RecorderManager();
+
+    // sampleRate is what the file is encoded at, one of the rates Opus supports. Submissions at other rates are resampled.
+    void Start(int uid, int sampleRate = 24000);
+    void SubmitPCM(int uid, const int16_t* samples, size_t count, int sampleRate = 24000);
+    // Submit a gap in the voice stream, keeps the recording's timeline intact
+    void SubmitSilence(int uid, size_t count, int sampleRate = 24000);
+    // Submit an already Opus encoded frame (length + data format). Avoids decoding/re-encoding path.
+    // Only copies the frame, the write happens on the worker.
+    void SubmitOpusPacket(int uid, const unsigned char* data, size_t len);
+    void Stop(int uid);
+    RecorderMemory Memory();
+
+private:
+    void Worker();
+    void EncodeAndWrite(RecordingSession& session, const int16_t* samples, size_t count, int sampleRate);
+    void EncodeSilence(RecordingSession& session, size_t count, int sampleRate);
+    // Encodes whole frames of samples at the session's rate, carrying the remainder over
+    static void EncodeFrames(RecordingSession& session, const int16_t* samples, size_t count);
+    static void WriteOpusPacket(RecordingSession& session, const unsigned char* data, size_t len);
+    void CloseSession(RecordingSession& session);
+    // Adds a task to the queue, caller holds mtx
+    void Push(RecordingTask&& task);
+    static size_t TaskBytes(const RecordingTask& task);
+    static size_t StreamBytes(const RecordingStream& stream);
+    std::string MakeFilename(int uid) const;
+
+    // Session encoders, initialised in place instead of created and destroyed for every recording
+    SteamOpus::EncoderPool encoders;
+    std::unordered_map<int, RecordingSession> sessions;
+    std::mutex mtx;
+    std::queue<RecordingTask> tasks;
+    std::condition_variable cv;
+    std::thread worker;
+    std::atomic<bool> running{true};
+    // Kept up to date as tasks come and go and the worker's buffers grow, so Memory never touches the worker's data
+    std::atomic<size_t> queueBytes{0};
+    std::atomic<size_t> streamBytes{0};
+};
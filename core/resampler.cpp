@@ -0,0 +1,140 @@
+#include "resampler.h"
+#include "sample_convert.h"
+#include <cmath>
+#include <cstring>
+
+// Same baseline as sample_convert.cpp, SSE2 is always there on x86-64
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RESAMPLER_SSE2
+#endif
+
+// Kaiser window shape, about 70 dB of stopband rejection
+#define RESAMPLER_KAISER_BETA 7.0
+// Passband edge as a share of the lower rate's Nyquist frequency
+#define RESAMPLER_CUTOFF 0.90
+
+static int Gcd(int a, int b) {
+    while (b) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Zeroth order modified Bessel function, for the Kaiser window
+static double BesselI0(double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 32; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+std::vector<double> KaiserLowPass(int taps, double cutoff) {
+    const double center = (taps - 1) / 2.0;
+    const double pi = 3.14159265358979323846;
+    const double i0Beta = BesselI0(RESAMPLER_KAISER_BETA);
+
+    std::vector<double> h(taps);
+    double sum = 0.0;
+    for (int k = 0; k < taps; k++) {
+        double t = k - center;
+        double sinc = t == 0.0 ? 2.0 * cutoff : std::sin(2.0 * pi * cutoff * t) / (pi * t);
+        double r = t / (center + 1.0);
+        h[k] = sinc * BesselI0(RESAMPLER_KAISER_BETA * std::sqrt(std::max(0.0, 1.0 - r * r))) / i0Beta;
+        sum += h[k];
+    }
+    for (double& c : h) c /= sum;
+    return h;
+}
+
+static float Dot(const float* a, const float* b) {
+#ifdef RESAMPLER_SSE2
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    for (int i = 0; i < RESAMPLER_TAPS; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    __m128 acc = _mm_add_ps(acc0, acc1);
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+    return _mm_cvtss_f32(acc);
+#else
+    float sum = 0.0f;
+    for (int i = 0; i < RESAMPLER_TAPS; i++)
+        sum += a[i] * b[i];
+    return sum;
+#endif
+}
+
+bool Resampler::Configure(int inRate, int outRate) {
+    if (inRate <= 0 || outRate <= 0)
+        return false;
+    if (inRate == m_inRate && outRate == m_outRate)
+        return true;
+
+    int g = Gcd(inRate, outRate);
+    int up = outRate / g;
+    int down = inRate / g;
+    if (up > RESAMPLER_MAX_FACTOR || down > RESAMPLER_MAX_FACTOR)
+        return false;
+
+    m_inRate = inRate;
+    m_outRate = outRate;
+    m_up = up;
+    m_down = down;
+
+    // One lowpass at the upsampled rate, cut below the Nyquist frequency of whichever side is lower.
+    // Branch p takes taps p, p + up, p + 2 * up... which is all zero stuffing would leave in play.
+    const int n = up * RESAMPLER_TAPS;
+    std::vector<double> h = KaiserLowPass(n, RESAMPLER_CUTOFF * 0.5 / std::max(up, down));
+
+    // Zero stuffing leaves 1 / up of the energy, so every branch has to sum to 1
+    m_coeffs.assign(n, 0.0f);
+    for (int p = 0; p < up; p++) {
+        for (int j = 0; j < RESAMPLER_TAPS; j++)
+            m_coeffs[p * RESAMPLER_TAPS + (RESAMPLER_TAPS - 1 - j)] = (float)(h[j * up + p] * up);
+    }
+
+    Reset();
+    return true;
+}
+
+void Resampler::Reset() {
+    m_pos = 0;
+    m_work.assign(RESAMPLER_TAPS - 1, 0.0f);
+}
+
+int Resampler::MaxOutput(int inSamples) const {
+    return (int)(((int64_t)inSamples * m_up + m_down - 1) / m_down);
+}
+
+int Resampler::Process(const int16_t* in, int inSamples, int16_t* out, int maxOut) {
+    if (m_coeffs.empty() || inSamples < 0 || maxOut < MaxOutput(inSamples))
+        return -1;
+
+    // History stays at the front, the block goes behind it. Both vectors only grow.
+    const int hist = RESAMPLER_TAPS - 1;
+    m_work.resize(hist + inSamples);
+    SampleConvert::ToFloat(in, m_work.data() + hist, inSamples);
+    if ((int)m_out.size() < MaxOutput(inSamples))
+        m_out.resize(MaxOutput(inSamples));
+
+    // Output position pos on the upsampled timeline is branch pos % up over the inputs ending at pos / up
+    int written = 0;
+    const int64_t end = (int64_t)inSamples * m_up;
+    for (; m_pos < end; m_pos += m_down) {
+        int64_t i = m_pos / m_up;
+        int p = (int)(m_pos - i * m_up);
+        m_out[written++] = Dot(&m_coeffs[p * RESAMPLER_TAPS], &m_work[i]);
+    }
+    m_pos -= end;
+
+    memmove(m_work.data(), m_work.data() + inSamples, hist * sizeof(float));
+    SampleConvert::ToInt16(m_out.data(), out, written);
+    return written;
+}
@@ -0,0 +1,47 @@
+// Sample rate conversion for sinks that want PCM at another rate than the stream,
+// e.g. 16 kHz for speech recognition or 48 kHz for archival.
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Taps per polyphase branch. A multiple of 8 for the SIMD dot product.
+#define RESAMPLER_TAPS 32
+// Largest up or down factor once the ratio is reduced, keeps the coefficient table small
+#define RESAMPLER_MAX_FACTOR 320
+
+// Kaiser windowed-sinc lowpass of taps coefficients, cutoff in cycles per sample, summing to 1 for unity gain at DC
+std::vector<double> KaiserLowPass(int taps, double cutoff);
+
+// Polyphase windowed-sinc resampler for one mono stream. Keeps the tail of the last block,
+// so a stream can be fed one packet at a time without clicks at the joins.
+class Resampler {
+public:
+    // Outputs false if the rates are out of range or their ratio doesn't reduce far enough
+    bool Configure(int inRate, int outRate);
+    int InRate() const { return m_inRate; }
+    int OutRate() const { return m_outRate; }
+    // Forgets the stream history, for the start of a new stream
+    void Reset();
+
+    // Most samples Process can output for inSamples
+    int MaxOutput(int inSamples) const;
+    // Outputs the samples written to out, or -1 if maxOut is too small or nothing is configured
+    int Process(const int16_t* in, int inSamples, int16_t* out, int maxOut);
+    // Heap held by the coefficient table and work buffers
+    size_t Bytes() const { return (m_coeffs.capacity() + m_work.capacity() + m_out.capacity()) * sizeof(float); }
+
+private:
+    int m_inRate = 0;
+    int m_outRate = 0;
+    // Upsample by m_up, then keep every m_down-th sample
+    int m_up = 1;
+    int m_down = 1;
+    // Position of the next output on the upsampled timeline, relative to the current block
+    int64_t m_pos = 0;
+    // m_up branches of RESAMPLER_TAPS each, reversed so they line up with the input
+    std::vector<float> m_coeffs;
+    // Last RESAMPLER_TAPS - 1 inputs followed by the current block, as floats
+    std::vector<float> m_work;
+    std::vector<float> m_out;
+};
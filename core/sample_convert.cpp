@@ -0,0 +1,49 @@
+#include "sample_convert.h"
+#include <algorithm>
+#include <cmath>
+
+// SSE2 is part of x86-64, and of any x86 build that targets it. Nothing to dispatch.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SAMPLE_CONVERT_SSE2
+#endif
+
+namespace SampleConvert {
+    void ToFloat(const int16_t* in, float* out, int samples) {
+        const float scale = 1.0f / 32768.0f;
+        int i = 0;
+#ifdef SAMPLE_CONVERT_SSE2
+        const __m128 vscale = _mm_set1_ps(scale);
+        for (; i + 8 <= samples; i += 8) {
+            __m128i s = _mm_loadu_si128((const __m128i*)(in + i));
+            // Sign extend: each sample lands in the top half of a 32-bit lane, then shifts back down
+            __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+            __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+            _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), vscale));
+            _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), vscale));
+        }
+#endif
+        for (; i < samples; i++) {
+            out[i] = in[i] * scale;
+        }
+    }
+
+    void ToInt16(const float* in, int16_t* out, int samples) {
+        int i = 0;
+#ifdef SAMPLE_CONVERT_SSE2
+        const __m128 vscale = _mm_set1_ps(32768.0f);
+        const __m128 vmin = _mm_set1_ps(-32768.0f);
+        const __m128 vmax = _mm_set1_ps(32767.0f);
+        for (; i + 8 <= samples; i += 8) {
+            // Clamped first, cvtps turns anything past int32 range into INT_MIN
+            __m128 a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(in + i), vscale), vmin), vmax);
+            __m128 b = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(in + i + 4), vscale), vmin), vmax);
+            _mm_storeu_si128((__m128i*)(out + i), _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+        }
+#endif
+        for (; i < samples; i++) {
+            float f = std::min(std::max(in[i] * 32768.0f, -32768.0f), 32767.0f);
+            out[i] = (int16_t)lrintf(f);
+        }
+    }
+}
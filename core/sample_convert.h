@@ -0,0 +1,11 @@
+// int16 <-> float sample conversion for the edges of the float pipeline.
+// Floats use the [-1, 1) scale of opus_decode_float and opus_encode_float.
+#pragma once
+#include <cstdint>
+
+namespace SampleConvert {
+    void ToFloat(const int16_t* in, float* out, int samples);
+
+    // Rounds to nearest and saturates, the same as libopus does for its own int16 output
+    void ToInt16(const float* in, int16_t* out, int samples);
+}
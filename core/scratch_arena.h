@@ -0,0 +1,57 @@
+// Bump allocator for per-packet scratch memory.
+// Each thread that processes voice owns one (ForThread, or the pipeline workers' own), and resets it for every packet.
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+
+// Room for a packet in the float pipeline: 40 KB of float PCM, 20 KB for the new packet and its int16 copy for the recorder
+#define SCRATCH_ARENA_DEFAULT_SZ (128 * 1024)
+
+class ScratchArena {
+public:
+    explicit ScratchArena(size_t capacity = SCRATCH_ARENA_DEFAULT_SZ)
+        : base(new char[capacity]), capacity(capacity) {
+        totalBytes.fetch_add(capacity, std::memory_order_relaxed);
+    }
+    ~ScratchArena() {
+        totalBytes.fetch_sub(capacity, std::memory_order_relaxed);
+        delete[] base;
+    }
+
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+
+    // Returns nullptr if the arena is exhausted. Memory is uninitialized and only valid until Reset.
+    template <typename T>
+    T* Alloc(size_t count, size_t align = 16) {
+        uintptr_t cur = (uintptr_t)(base + used);
+        uintptr_t aligned = (cur + (align - 1)) & ~(uintptr_t)(align - 1);
+        size_t offset = (size_t)(aligned - (uintptr_t)base);
+        size_t bytes = count * sizeof(T);
+        if (offset + bytes > capacity)
+            return nullptr;
+        used = offset + bytes;
+        return (T*)aligned;
+    }
+
+    void Reset() { used = 0; }
+    size_t Capacity() const { return capacity; }
+    size_t Used() const { return used; }
+
+    // Bytes held by every arena alive in the process, thread arenas and pipeline workers alike
+    static size_t TotalBytes() { return totalBytes.load(std::memory_order_relaxed); }
+
+    // The calling thread's arena, for work done outside the pipeline workers
+    static ScratchArena& ForThread() {
+        static thread_local ScratchArena arena;
+        return arena;
+    }
+
+private:
+    char* base;
+    size_t capacity;
+    size_t used = 0;
+
+    static inline std::atomic<size_t> totalBytes{0};
+};
@@ -0,0 +1,253 @@
+#include "steam_voice.h"
+#include <cstring>
+#include <algorithm>
+
+//Zeros fed to the codec when the samples it holds back need completing to a frame
+#define SILENCE_PAD_CHUNK 512
+
+namespace SteamVoice {
+	//The codec calls that differ between the int16 and float pipelines. Sizes are in samples.
+	static int CodecDecompress(IVoiceCodec* codec, const char* payload, int len, int16_t* pcm, int maxSamples) {
+		return codec->Decompress(payload, len, (char*)pcm, maxSamples * 2);
+	}
+
+	static int CodecDecompress(IVoiceCodec* codec, const char* payload, int len, float* pcm, int maxSamples) {
+		return codec->DecompressFloat(payload, len, pcm, maxSamples);
+	}
+
+	static int CodecDecompressFormat(IVoiceCodec* codec, int opcode, const char* payload, int len, int16_t* pcm, int maxSamples) {
+		return codec->DecompressFormat(opcode, payload, len, (char*)pcm, maxSamples * 2);
+	}
+
+	static int CodecDecompressFormat(IVoiceCodec* codec, int opcode, const char* payload, int len, float* pcm, int maxSamples) {
+		//Format decoders only output int16. They write into the front of the space, which is then widened back to front in place.
+		int samples = codec->DecompressFormat(opcode, payload, len, (char*)pcm, maxSamples * 2);
+		for (int i = samples - 1; i >= 0; i--) {
+			int16_t v;
+			memcpy(&v, (const char*)pcm + i * sizeof(int16_t), sizeof(v));
+			pcm[i] = v * (1.0f / 32768.0f);
+		}
+		return samples;
+	}
+
+	static int CodecCompress(IVoiceCodec* codec, const int16_t* pcm, int samples, char* out, int maxOut) {
+		return codec->Compress((const char*)pcm, samples, out, maxOut, false);
+	}
+
+	static int CodecCompress(IVoiceCodec* codec, const float* pcm, int samples, char* out, int maxOut) {
+		return codec->CompressFloat(pcm, samples, out, maxOut, false);
+	}
+
+	template <typename T>
+	static int DecodeSpansOf(IVoiceCodec* codec, const char* compressedData, int compressedLen, T* pcm, int maxSamples, DecodedVoice& out) {
+		out = DecodedVoice();
+
+		VoicePacketView view(compressedData, compressedLen);
+		VoiceOp op;
+		while (view.Next(op)) {
+			switch (op.opcode) {
+			case OP_SILENCE:
+				//Number of silent samples. Kept as a span so nothing downstream has to process zeros.
+				if (!out.Add(op.value, true))
+					return -1;
+				break;
+			case OP_SAMPLERATE:
+				//Contains the samplerate for the stream. Always 24000 from the game itself, but other clients differ.
+				//The codec follows it and decodes every format to the rate it encodes at, GetSampleRate below.
+				if (!codec->SetSampleRate(op.value))
+					return -1;
+				break;
+			case OP_CODEC_OPUSPLC:
+			case OP_CODEC_OPUS:
+			case OP_CODEC_RAW:
+			case OP_CODEC_SILK:
+			case OP_CODEC_LEGACY: {
+				//OP_CODEC_OPUSPLC is the codec's own format, it walks the [len][seq][opus] frames itself for loss concealment.
+				//Anything else goes to the decoder registered for the opcode.
+				T* curWrite = pcm + out.pcmSamples;
+				int maxWrite = maxSamples - out.pcmSamples;
+				int decompressedSamples = op.opcode == OP_CODEC_OPUSPLC
+					? CodecDecompress(codec, op.payload, op.value, curWrite, maxWrite)
+					: CodecDecompressFormat(codec, op.opcode, op.payload, op.value, curWrite, maxWrite);
+				//The codec's own format may hold every frame back waiting on a missing one, or drop them as late
+				if (decompressedSamples < 0 || (decompressedSamples == 0 && op.opcode != OP_CODEC_OPUSPLC))
+					return -1;
+
+				if (!out.Add(decompressedSamples, false))
+					return -1;
+				break;
+			}
+			}
+		}
+
+		if (view.Corrupt())
+			return -1;
+
+		out.sampleRate = codec->GetSampleRate();
+		return out.pcmSamples;
+	}
+
+	int DecodeSpans(IVoiceCodec* codec, const char* compressedData, int compressedLen, int16_t* pcm, int maxSamples, DecodedVoice& out) {
+		return DecodeSpansOf(codec, compressedData, compressedLen, pcm, maxSamples, out);
+	}
+
+	int DecodeSpans(IVoiceCodec* codec, const char* compressedData, int compressedLen, float* pcm, int maxSamples, DecodedVoice& out) {
+		return DecodeSpansOf(codec, compressedData, compressedLen, pcm, maxSamples, out);
+	}
+
+	template <typename T>
+	static int ExpandSilenceOf(const DecodedVoice& voice, T* pcm, int maxSamples) {
+		if (voice.Samples() > maxSamples)
+			return -1;
+
+		//Back to front, so every span moves right onto space nothing still needs
+		int readEnd = voice.pcmSamples;
+		int writeEnd = voice.Samples();
+		for (int i = voice.spanCount - 1; i >= 0; i--) {
+			const VoiceSpan& span = voice.spans[i];
+			writeEnd -= span.samples;
+			if (span.silent) {
+				memset(pcm + writeEnd, 0, span.samples * sizeof(T));
+			}
+			else {
+				readEnd -= span.samples;
+				if (readEnd != writeEnd)
+					memmove(pcm + writeEnd, pcm + readEnd, span.samples * sizeof(T));
+			}
+		}
+
+		return voice.Samples();
+	}
+
+	int ExpandSilence(const DecodedVoice& voice, int16_t* pcm, int maxSamples) {
+		return ExpandSilenceOf(voice, pcm, maxSamples);
+	}
+
+	int ExpandSilence(const DecodedVoice& voice, float* pcm, int maxSamples) {
+		return ExpandSilenceOf(voice, pcm, maxSamples);
+	}
+
+	//One run of audio: the payload is encoded straight behind the fixed header, which then goes out in a single store
+	template <typename T>
+	static int CompressRun(uint64_t steamid, IVoiceCodec* codec, const T* pcm, int samples, char* out, int maxOut, int sampleRate, PacketOffsets* offsets) {
+		using namespace OpusPacketLayout;
+		if (maxOut < PacketSize(0))
+			return -1;
+
+		int payloadLen = CodecCompress(codec, pcm, samples, out + PAYLOAD, maxOut - PacketSize(0));
+		if (payloadLen < 0 || payloadLen > UINT16_MAX)
+			return -1;
+
+		OpusPacketHeader header = { steamid, OP_SAMPLERATE, (uint16_t)sampleRate, OP_CODEC_OPUSPLC, (uint16_t)payloadLen };
+		memcpy(out, &header, sizeof(header));
+
+		//Nothing encoded yet (the codec is waiting for a whole frame), the crc goes over the empty codec opcode
+		int crcAt = payloadLen > 0 ? CrcOffset(payloadLen) : CODEC_OP;
+		CRC32::CRC32_t crc = CRC32::ProcessSingleBuffer(out, crcAt);
+		memcpy(out + crcAt, &crc, sizeof(crc));
+
+		if (offsets) {
+			offsets->size = crcAt + (int)sizeof(crc);
+			offsets->payload = PAYLOAD;
+			offsets->payloadLen = payloadLen;
+			offsets->crc = crcAt;
+		}
+		return crcAt + (int)sizeof(crc);
+	}
+
+	template <typename T>
+	static int CompressSpansOf(uint64_t steamid, IVoiceCodec* codec, const DecodedVoice& voice, const T* pcm, char* compressedOut, int maxCompressed, int sampleRate, PacketOffsets* offsets) {
+		static const T zeros[SILENCE_PAD_CHUNK] = {};
+
+		if (voice.spanCount == 1 && !voice.spans[0].silent)
+			return CompressRun(steamid, codec, pcm, voice.pcmSamples, compressedOut, maxCompressed, sampleRate, offsets);
+
+		VoicePacketWriter writer(compressedOut, maxCompressed);
+		writer.WriteSteamID(steamid);
+		writer.WriteOp(OP_SAMPLERATE, (uint16_t)sampleRate);
+
+		const T* curRead = pcm;
+		for (int i = 0; i < voice.spanCount; i++) {
+			const VoiceSpan& span = voice.spans[i];
+			int space;
+			char* payload;
+
+			if (!span.silent) {
+				payload = writer.BeginOpusPayload(space);
+				int compressedBytes = CodecCompress(codec, curRead, span.samples, payload, space);
+				if (compressedBytes < 0)
+					return -1;
+
+				//Zero bytes when the samples only filled the codec's buffer, EndOpusPayload drops the empty opcode
+				writer.EndOpusPayload(compressedBytes);
+				curRead += span.samples;
+				continue;
+			}
+
+			//Samples still buffered in the codec belong before the gap. Complete their frame with the first
+			//samples of the silence so the timeline stays in order, the rest goes out as OP_SILENCE.
+			int silent = span.samples;
+			int pending = codec->PendingSamples();
+			int pad = pending > 0 ? std::min(silent, codec->FrameSamples() - pending) : 0;
+			if (pad > 0) {
+				payload = writer.BeginOpusPayload(space);
+				int compressedBytes = 0;
+				for (int done = 0; done < pad; ) {
+					int chunk = std::min(pad - done, SILENCE_PAD_CHUNK);
+					int bytes = CodecCompress(codec, zeros, chunk, payload + compressedBytes, space - compressedBytes);
+					if (bytes < 0)
+						return -1;
+
+					compressedBytes += bytes;
+					done += chunk;
+				}
+
+				writer.EndOpusPayload(compressedBytes);
+				silent -= pad;
+			}
+
+			while (silent > 0) {
+				uint16_t run = (uint16_t)std::min(silent, 0xFFFF);
+				writer.WriteOp(OP_SILENCE, run);
+				silent -= run;
+			}
+		}
+
+		int written = writer.Finish();
+		if (offsets && written > 0) {
+			*offsets = PacketOffsets();
+			offsets->size = written;
+			offsets->crc = written - (int)sizeof(CRC32::CRC32_t);
+		}
+		return written;
+	}
+
+	int CompressSpans(uint64_t steamid, IVoiceCodec* codec, const DecodedVoice& voice, const int16_t* pcm, char* compressedOut, int maxCompressed, int sampleRate, PacketOffsets* offsets) {
+		return CompressSpansOf(steamid, codec, voice, pcm, compressedOut, maxCompressed, sampleRate, offsets);
+	}
+
+	int CompressSpans(uint64_t steamid, IVoiceCodec* codec, const DecodedVoice& voice, const float* pcm, char* compressedOut, int maxCompressed, int sampleRate, PacketOffsets* offsets) {
+		return CompressSpansOf(steamid, codec, voice, pcm, compressedOut, maxCompressed, sampleRate, offsets);
+	}
+
+	//Outputs bytes written or -1 on corruption
+	int DecompressIntoBuffer(IVoiceCodec* codec, const char* compressedData, int compressedLen, char* decompressedOut, int maxDecompressed) {
+		DecodedVoice voice;
+		int16_t* pcm = (int16_t*)decompressedOut;
+		if (DecodeSpans(codec, compressedData, compressedLen, pcm, maxDecompressed / 2, voice) < 0)
+			return -1;
+
+		int samples = ExpandSilence(voice, pcm, maxDecompressed / 2);
+		if (samples < 0)
+			return -1;
+
+		return samples * 2;
+	}
+
+	//Outputs number of bytes written or -1 on failure
+	int CompressIntoBuffer(uint64_t steamid, IVoiceCodec* codec, const char* inputData, int inputLen, char* compressedOut, int maxCompressed, int sampleRate) {
+		DecodedVoice voice;
+		voice.Add(inputLen / 2, false);
+		return CompressSpans(steamid, codec, voice, (const int16_t*)inputData, compressedOut, maxCompressed, sampleRate);
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <cstdint>
+#include "ivoicecodec.h"
+#include "voice_packet.h"
+
+namespace SteamVoice {
+	//Calls fn(const unsigned char* opus, uint16_t len, uint16_t seq) for every Opus frame in the packet's
+	//OP_CODEC_OPUSPLC payloads, without decoding anything. Outputs the number of frames or -1 on corruption.
+	template <typename Fn>
+	int ForEachOpusFrame(const char* compressedData, int compressedLen, Fn&& fn) {
+		VoicePacketView view(compressedData, compressedLen);
+		return view.ForEachOpusFrame([&fn](const OpusFrame& frame) {
+			fn(frame.data, frame.len, frame.seq);
+		});
+	}
+
+	#define VOICE_MAX_SPANS 32
+
+	//A run of decoded audio. Silent runs are only a length, no samples are written for them.
+	struct VoiceSpan {
+		int samples;
+		bool silent;
+	};
+
+	//Timeline of one decoded packet. The samples of the non-silent spans sit back to back in the PCM buffer.
+	struct DecodedVoice {
+		VoiceSpan spans[VOICE_MAX_SPANS];
+		int spanCount = 0;
+		int pcmSamples = 0;
+		int silentSamples = 0;
+		//Rate of the samples, from the packet's OP_SAMPLERATE
+		int sampleRate = 0;
+
+		int Samples() const { return pcmSamples + silentSamples; }
+
+		//Merges with the previous span when it's the same kind. Outputs false if out of spans.
+		bool Add(int samples, bool silent) {
+			if (samples <= 0)
+				return true;
+
+			if (spanCount > 0 && spans[spanCount - 1].silent == silent) {
+				spans[spanCount - 1].samples += samples;
+			}
+			else {
+				if (spanCount == VOICE_MAX_SPANS)
+					return false;
+				spans[spanCount++] = VoiceSpan{samples, silent};
+			}
+			(silent ? silentSamples : pcmSamples) += samples;
+			return true;
+		}
+	};
+
+	//Decodes the packet's audio into pcm and its OP_SILENCE gaps into silent spans, without zero filling them.
+	//Outputs the PCM samples written or -1 on corruption.
+	int DecodeSpans(IVoiceCodec* codec, const char* compressedData, int compressedLen, int16_t* pcm, int maxSamples, DecodedVoice& out);
+	//Float pipeline version, through the codec's DecompressFloat. Other formats are widened from int16.
+	int DecodeSpans(IVoiceCodec* codec, const char* compressedData, int compressedLen, float* pcm, int maxSamples, DecodedVoice& out);
+
+	//Zero fills the silent spans in place, so pcm holds the packet's whole timeline. Outputs total samples or -1 if it doesn't fit.
+	int ExpandSilence(const DecodedVoice& voice, int16_t* pcm, int maxSamples);
+	int ExpandSilence(const DecodedVoice& voice, float* pcm, int maxSamples);
+
+	//Encodes the spans in order, silent ones as OP_SILENCE. Outputs bytes written or -1 on failure.
+	//A single run of audio takes a fast path with the OpusPacketLayout, offsets then says where its payload and crc are.
+	int CompressSpans(uint64_t steamid, IVoiceCodec* codec, const DecodedVoice& voice, const int16_t* pcm, char* compressedOut, int maxCompressed, int sampleRate, PacketOffsets* offsets = nullptr);
+	//Float pipeline version, through the codec's CompressFloat
+	int CompressSpans(uint64_t steamid, IVoiceCodec* codec, const DecodedVoice& voice, const float* pcm, char* compressedOut, int maxCompressed, int sampleRate, PacketOffsets* offsets = nullptr);
+
+	//Outputs bytes written or -1 on corruption. Silence is zero filled.
+	int DecompressIntoBuffer(IVoiceCodec* codec, const char* compressedData, int compressedLen, char* decompressedOut, int maxDecompressed);
+
+	//Outputs number of bytes written or -1 on failure
+	int CompressIntoBuffer(uint64_t steamid, IVoiceCodec* codec, const char* inputData, int inputLen, char* compressedOut, int maxCompressed, int sampleRate);
+}
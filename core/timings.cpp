@@ -0,0 +1,147 @@
+#include "timings.h"
+
+#ifdef TRANSCRIPT_TIMINGS
+#include <chrono>
+#include <thread>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+namespace Timings {
+    static Histogram stages[STAGE_COUNT];
+    static Histogram effects[TIMINGS_MAX_EFFECTS];
+    static double nsPerCycle = 1.0;
+
+    static const char* stageNames[STAGE_COUNT] = {
+        "verify",
+        "relay",
+        "speaking",
+        "decompress",
+        "effect",
+        "compress",
+        "record",
+        "trampoline",
+    };
+
+    static int Log2(uint64_t v) {
+#if defined(_MSC_VER)
+        unsigned long idx;
+        if (_BitScanReverse(&idx, (unsigned long)(v >> 32))) return (int)idx + 32;
+        _BitScanReverse(&idx, (unsigned long)v);
+        return (int)idx;
+#else
+        return 63 - __builtin_clzll(v);
+#endif
+    }
+
+    static int BucketFor(uint64_t v) {
+        if (v < 4) return (int)v;
+        int msb = Log2(v);
+        int sub = (int)(v >> (msb - 2)) & 3;
+        return (msb - 1) * 4 + sub;
+    }
+
+    // Midpoint of the bucket's range, what percentiles report
+    static double BucketValue(int b) {
+        if (b < 4) return b;
+        int msb = b / 4 + 1;
+        double lower = (double)((uint64_t)(4 + b % 4) << (msb - 2));
+        double width = (double)(1ull << (msb - 2));
+        return lower + width / 2;
+    }
+
+    void Histogram::Record(uint64_t cycles) {
+        buckets[BucketFor(cycles)].fetch_add(1, std::memory_order_relaxed);
+        uint64_t cur = max.load(std::memory_order_relaxed);
+        while (cycles > cur && !max.compare_exchange_weak(cur, cycles, std::memory_order_relaxed)) {}
+    }
+
+    void Histogram::Reset() {
+        for (auto& b : buckets) b.store(0, std::memory_order_relaxed);
+        max.store(0, std::memory_order_relaxed);
+    }
+
+    uint64_t Now() {
+#if defined(_MSC_VER) || defined(__i386__) || defined(__x86_64__)
+        return __rdtsc();
+#else
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    void Init() {
+#if defined(_MSC_VER) || defined(__i386__) || defined(__x86_64__)
+        using Clock = std::chrono::steady_clock;
+        Clock::time_point t0 = Clock::now();
+        uint64_t c0 = __rdtsc();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        uint64_t c1 = __rdtsc();
+        Clock::time_point t1 = Clock::now();
+        double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+        if (c1 > c0) nsPerCycle = ns / (double)(c1 - c0);
+#endif
+        Reset();
+    }
+
+    void Record(Stage stage, uint64_t cycles) {
+        stages[stage].Record(cycles);
+    }
+
+    void RecordEffect(int effect, uint64_t cycles) {
+        if (effect >= 0 && effect < TIMINGS_MAX_EFFECTS) effects[effect].Record(cycles);
+    }
+
+    void Reset() {
+        for (auto& h : stages) h.Reset();
+        for (auto& h : effects) h.Reset();
+    }
+
+    static Summary SummarizeHistogram(const Histogram& h) {
+        Summary s;
+        uint64_t counts[TIMINGS_BUCKETS];
+        for (int i = 0; i < TIMINGS_BUCKETS; i++) {
+            counts[i] = h.buckets[i].load(std::memory_order_relaxed);
+            s.count += counts[i];
+        }
+        s.maxUs = h.max.load(std::memory_order_relaxed) * nsPerCycle / 1000.0;
+        if (s.count == 0) return s;
+
+        uint64_t p50 = (s.count + 1) / 2;
+        uint64_t p99 = s.count - s.count / 100;
+        uint64_t seen = 0;
+        bool have50 = false;
+        for (int i = 0; i < TIMINGS_BUCKETS; i++) {
+            seen += counts[i];
+            if (!have50 && seen >= p50) {
+                s.p50us = BucketValue(i) * nsPerCycle / 1000.0;
+                have50 = true;
+            }
+            if (seen >= p99) {
+                s.p99us = BucketValue(i) * nsPerCycle / 1000.0;
+                break;
+            }
+        }
+        // Bucket midpoints can overshoot the real maximum
+        if (s.p50us > s.maxUs) s.p50us = s.maxUs;
+        if (s.p99us > s.maxUs) s.p99us = s.maxUs;
+        return s;
+    }
+
+    Summary Summarize(Stage stage) {
+        return SummarizeHistogram(stages[stage]);
+    }
+
+    Summary SummarizeEffect(int effect) {
+        if (effect < 0 || effect >= TIMINGS_MAX_EFFECTS) return Summary();
+        return SummarizeHistogram(effects[effect]);
+    }
+
+    const char* StageName(Stage stage) {
+        return stageNames[stage];
+    }
+}
+
+#endif
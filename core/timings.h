@@ -0,0 +1,83 @@
+// Per-stage latency histograms for the voice hook.
+// Cycle counts from the TSC go into fixed log-scale buckets, so recording is a couple of relaxed atomic adds.
+// Define TRANSCRIPT_NO_TIMINGS to compile all of it out.
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+#if !defined(TRANSCRIPT_NO_TIMINGS)
+#define TRANSCRIPT_TIMINGS
+#endif
+
+namespace Timings {
+    enum Stage {
+        STAGE_VERIFY,       // CRC check of the incoming packet
+        STAGE_RELAY,        // copy + send to the relay socket
+        STAGE_SPEAKING,     // speaking state bookkeeping
+        STAGE_DECOMPRESS,   // SteamVoice::DecodeSpans
+        STAGE_EFFECT,       // audio effect, also split per effect type
+        STAGE_COMPRESS,     // SteamVoice::CompressSpans, CRC included
+        STAGE_RECORD,       // recorder submission
+        STAGE_TRAMPOLINE,   // original SV_BroadcastVoiceData
+        STAGE_COUNT
+    };
+
+    #define TIMINGS_MAX_EFFECTS 8
+
+    // Buckets 0-3 hold exact values, after that 4 buckets per power of two (~19% wide).
+    #define TIMINGS_BUCKETS 256
+
+    struct Histogram {
+        std::atomic<uint32_t> buckets[TIMINGS_BUCKETS];
+        std::atomic<uint64_t> max;
+
+        void Record(uint64_t cycles);
+        void Reset();
+    };
+
+    struct Summary {
+        uint64_t count = 0;
+        double p50us = 0;
+        double p99us = 0;
+        double maxUs = 0;
+    };
+
+    // Calibrates the TSC against steady_clock. Call once before recording.
+    void Init();
+    uint64_t Now();
+
+    void Record(Stage stage, uint64_t cycles);
+    void RecordEffect(int effect, uint64_t cycles);
+    void Reset();
+
+    Summary Summarize(Stage stage);
+    Summary SummarizeEffect(int effect);
+    const char* StageName(Stage stage);
+
+    class ScopedStage {
+    public:
+        explicit ScopedStage(Stage stage, int effect = -1) : stage(stage), effect(effect), start(Now()) {}
+        ~ScopedStage() {
+            uint64_t elapsed = Now() - start;
+            Record(stage, elapsed);
+            if (effect >= 0) RecordEffect(effect, elapsed);
+        }
+
+    private:
+        Stage stage;
+        int effect;
+        uint64_t start;
+    };
+}
+
+#define TIMINGS_CONCAT_(a, b) a##b
+#define TIMINGS_CONCAT(a, b) TIMINGS_CONCAT_(a, b)
+
+#ifdef TRANSCRIPT_TIMINGS
+    // Times the rest of the enclosing scope
+    #define TIME_STAGE(stage) Timings::ScopedStage TIMINGS_CONCAT(_stageTimer, __LINE__)(Timings::stage)
+    #define TIME_EFFECT(effect) Timings::ScopedStage TIMINGS_CONCAT(_stageTimer, __LINE__)(Timings::STAGE_EFFECT, effect)
+#else
+    #define TIME_STAGE(stage) ((void)0)
+    #define TIME_EFFECT(effect) ((void)0)
+#endif
@@ -0,0 +1,129 @@
+#include "voice_capture.h"
+#include <cstring>
+
+VoiceCaptureWriter::~VoiceCaptureWriter() {
+    Close();
+}
+
+bool VoiceCaptureWriter::Open(const std::string& path) {
+    Close();
+
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) return false;
+    fwrite(VOICE_CAPTURE_MAGIC, 1, 8, f);
+
+    file = f;
+    stopping = false;
+    pending.clear();
+    pending.reserve(VOICE_CAPTURE_FLUSH_SZ * 2);
+    captured = 0;
+    dropped = 0;
+    start = std::chrono::steady_clock::now();
+    writer = std::thread([this]() { WriterLoop(); });
+    open = true;
+    return true;
+}
+
+void VoiceCaptureWriter::Close() {
+    if (!open) return;
+    open = false;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    cv.notify_one();
+    writer.join();
+    fclose(file);
+    file = nullptr;
+}
+
+void VoiceCaptureWriter::Append(int slot, int userid, const char* data, int nBytes) {
+    if (nBytes <= 0 || nBytes > UINT16_MAX) return;
+
+    uint64_t ts = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    uint16_t slot16 = (uint16_t)slot;
+    int32_t uid32 = userid;
+    uint16_t len = (uint16_t)nBytes;
+
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        size_t at = pending.size();
+        if (at + VOICE_CAPTURE_RECORD_HDR + len > VOICE_CAPTURE_MAX_PENDING) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        pending.resize(at + VOICE_CAPTURE_RECORD_HDR + len);
+        char* p = pending.data() + at;
+        memcpy(p, &ts, sizeof(ts)); p += sizeof(ts);
+        memcpy(p, &slot16, sizeof(slot16)); p += sizeof(slot16);
+        memcpy(p, &uid32, sizeof(uid32)); p += sizeof(uid32);
+        memcpy(p, &len, sizeof(len)); p += sizeof(len);
+        memcpy(p, data, len);
+        wake = at < VOICE_CAPTURE_FLUSH_SZ && pending.size() >= VOICE_CAPTURE_FLUSH_SZ;
+    }
+    captured.fetch_add(1, std::memory_order_relaxed);
+    if (wake) cv.notify_one();
+}
+
+void VoiceCaptureWriter::WriterLoop() {
+    std::vector<char> writing;
+    writing.reserve(VOICE_CAPTURE_FLUSH_SZ * 2);
+    for (;;) {
+        bool exiting;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            // Flush at least a few times a second so a crash loses little
+            cv.wait_for(lock, std::chrono::milliseconds(250), [this]{ return stopping || pending.size() >= VOICE_CAPTURE_FLUSH_SZ; });
+            writing.swap(pending);
+            exiting = stopping;
+        }
+        if (!writing.empty()) {
+            fwrite(writing.data(), 1, writing.size(), file);
+            writing.clear();
+        }
+        if (exiting) break;
+    }
+    fflush(file);
+}
+
+VoiceCaptureReader::~VoiceCaptureReader() {
+    if (file) fclose(file);
+}
+
+bool VoiceCaptureReader::Open(const std::string& path) {
+    if (file) fclose(file);
+    file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+
+    char magic[8];
+    if (fread(magic, 1, sizeof(magic), file) != sizeof(magic) || memcmp(magic, VOICE_CAPTURE_MAGIC, 8) != 0) {
+        fclose(file);
+        file = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool VoiceCaptureReader::Next(CaptureRecord& rec) {
+    if (!file) return false;
+
+    char hdr[VOICE_CAPTURE_RECORD_HDR];
+    if (fread(hdr, 1, sizeof(hdr), file) != sizeof(hdr)) return false;
+
+    uint64_t ts;
+    uint16_t slot16;
+    int32_t uid32;
+    uint16_t len;
+    const char* p = hdr;
+    memcpy(&ts, p, sizeof(ts)); p += sizeof(ts);
+    memcpy(&slot16, p, sizeof(slot16)); p += sizeof(slot16);
+    memcpy(&uid32, p, sizeof(uid32)); p += sizeof(uid32);
+    memcpy(&len, p, sizeof(len));
+
+    rec.timestampNs = ts;
+    rec.slot = slot16;
+    rec.userid = uid32;
+    rec.data.resize(len);
+    return fread(rec.data.data(), 1, len, file) == len;
+}
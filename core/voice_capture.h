@@ -0,0 +1,70 @@
+// Raw voice packet capture, for replaying real traffic through the transcode path offline.
+// The hook only appends to an in-memory buffer, a background thread does the file writes.
+// File layout: "TVCAP001", then per packet [u64 timestamp ns][u16 slot][i32 userid][u16 nBytes][nBytes of packet], little endian.
+#pragma once
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+
+#define VOICE_CAPTURE_MAGIC "TVCAP001"
+#define VOICE_CAPTURE_RECORD_HDR (sizeof(uint64_t) + sizeof(uint16_t) + sizeof(int32_t) + sizeof(uint16_t))
+// Buffered bytes that wake the writer early, and the most we hold before dropping packets
+#define VOICE_CAPTURE_FLUSH_SZ (64 * 1024)
+#define VOICE_CAPTURE_MAX_PENDING (4 * 1024 * 1024)
+
+struct CaptureRecord {
+    uint64_t timestampNs = 0;   // steady clock, relative to when the capture was opened
+    int slot = 0;
+    int userid = 0;
+    std::vector<char> data;
+};
+
+class VoiceCaptureWriter {
+public:
+    ~VoiceCaptureWriter();
+
+    // Ends any capture in progress and starts a new one. Returns false if the file can't be created.
+    bool Open(const std::string& path);
+    // Writes out everything appended so far and closes the file
+    void Close();
+    bool IsOpen() const { return open.load(std::memory_order_relaxed); }
+
+    // Copies the packet into the pending buffer. Drops it if the writer has fallen too far behind.
+    void Append(int slot, int userid, const char* data, int nBytes);
+
+    uint64_t Captured() const { return captured.load(std::memory_order_relaxed); }
+    uint64_t Dropped() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    void WriterLoop();
+
+    FILE* file = nullptr;
+    std::thread writer;
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::vector<char> pending;  // filled by Append, swapped out by the writer
+    bool stopping = false;
+    std::atomic<bool> open{false};
+    std::chrono::steady_clock::time_point start;
+    std::atomic<uint64_t> captured{0};
+    std::atomic<uint64_t> dropped{0};
+};
+
+class VoiceCaptureReader {
+public:
+    ~VoiceCaptureReader();
+
+    // Returns false if the file can't be read or isn't a capture
+    bool Open(const std::string& path);
+    // Reads the next packet into rec, reusing its buffer. Returns false at the end of the file or on a truncated record.
+    bool Next(CaptureRecord& rec);
+
+private:
+    FILE* file = nullptr;
+};
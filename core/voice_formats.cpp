@@ -0,0 +1,185 @@
+#include "voice_formats.h"
+#include "resampler.h"
+#include "opus.h"
+#include <cstdlib>
+#include <cstring>
+
+namespace SteamVoice {
+	//OP_CODEC_RAW: the payload already is 16-bit PCM at the stream's rate, one copy into the output.
+	//Resampled in place when the stream's rate isn't one the codec runs at.
+	class RawDecoder : public IFormatDecoder {
+	public:
+		int Decode(const char* payload, int len, int16_t* pcm, int maxSamples) override {
+			if (!rateOk)
+				return -1;
+
+			int samples = len / (int)sizeof(int16_t);
+			if (samples > maxSamples)
+				return -1;
+
+			memcpy(pcm, payload, samples * sizeof(int16_t));
+			if (!resample)
+				return samples;
+
+			//The resampler takes its input in before it writes anything out
+			return resampler.Process(pcm, samples, pcm, maxSamples);
+		}
+
+		void Reset() override {
+			if (resample) resampler.Reset();
+		}
+
+		bool SetSampleRate(int streamRate, int outRate) override {
+			resample = streamRate != outRate;
+			rateOk = !resample || resampler.Configure(streamRate, outRate);
+			if (rateOk) resampler.Reset();
+			return rateOk;
+		}
+
+		size_t Bytes() const override {
+			return sizeof(*this) + resampler.Bytes();
+		}
+
+	private:
+		Resampler resampler;
+		bool resample = false;
+		bool rateOk = true;
+	};
+
+	//OP_CODEC_OPUS: a single plain Opus packet, without the [len][seq] framing of OP_CODEC_OPUSPLC.
+	//Opus decodes to any of its rates whatever it was encoded at, so this outputs at the codec's rate directly.
+	class OpusPacketDecoder : public IFormatDecoder {
+	public:
+		OpusPacketDecoder() {
+			//The same memory at any rate, so a rate change re-initialises it in place
+			dec = (OpusDecoder*)malloc(opus_decoder_get_size(1));
+			rateOk = dec && opus_decoder_init(dec, 24000, 1) == OPUS_OK;
+		}
+
+		~OpusPacketDecoder() override {
+			free(dec);
+		}
+
+		int Decode(const char* payload, int len, int16_t* pcm, int maxSamples) override {
+			if (!rateOk || len <= 0)
+				return -1;
+
+			int samples = opus_decode(dec, (const unsigned char*)payload, len, pcm, maxSamples, 0);
+			return samples < 0 ? -1 : samples;
+		}
+
+		void Reset() override {
+			if (rateOk) opus_decoder_ctl(dec, OPUS_RESET_STATE);
+		}
+
+		bool SetSampleRate(int streamRate, int outRate) override {
+			if (outRate == rate && rateOk)
+				return true;
+
+			rate = outRate;
+			rateOk = dec && opus_decoder_init(dec, outRate, 1) == OPUS_OK;
+			return rateOk;
+		}
+
+		size_t Bytes() const override {
+			return sizeof(*this) + (dec ? opus_decoder_get_size(1) : 0);
+		}
+
+	private:
+		OpusDecoder* dec = nullptr;
+		int rate = 24000;
+		bool rateOk = false;
+	};
+
+	template <typename T>
+	static IFormatDecoder* Create() {
+		return new T();
+	}
+
+	//OP_CODEC_OPUSPLC is handled by the stream's own codec. OP_CODEC_LEGACY and OP_CODEC_SILK
+	//need codec libraries we don't ship, builds that have them can add them with RegisterFormat.
+	static VoiceFormat formats[OP_MAX] = {
+		{}, //OP_SILENCE
+		{}, //OP_CODEC_LEGACY
+		{}, //OP_CODEC_UNK
+		{"raw", &Create<RawDecoder>},
+		{}, //OP_CODEC_SILK
+		{"opus", &Create<OpusPacketDecoder>},
+	};
+
+	const VoiceFormat* FindFormat(int opcode) {
+		if (opcode < 0 || opcode >= OP_MAX || formats[opcode].create == nullptr)
+			return nullptr;
+
+		return &formats[opcode];
+	}
+
+	void RegisterFormat(int opcode, const char* name, FormatDecoderFactory create) {
+		if (opcode >= 0 && opcode < OP_MAX)
+			formats[opcode] = VoiceFormat{name, create};
+	}
+
+	FormatDecoders::~FormatDecoders() {
+		Clear();
+	}
+
+	IFormatDecoder* FormatDecoders::Get(int opcode) {
+		if (opcode < 0 || opcode >= OP_MAX)
+			return nullptr;
+
+		if (decoders[opcode] == nullptr) {
+			const VoiceFormat* format = FindFormat(opcode);
+			if (format == nullptr)
+				return nullptr;
+
+			IFormatDecoder* d = format->create();
+			if (d == nullptr)
+				return nullptr;
+
+			d->SetSampleRate(streamRate, outRate);
+			totalBytes.fetch_add(d->Bytes(), std::memory_order_relaxed);
+			decoders[opcode] = d;
+		}
+		return decoders[opcode];
+	}
+
+	int FormatDecoders::Decode(int opcode, const char* payload, int len, int16_t* pcm, int maxSamples) {
+		IFormatDecoder* d = Get(opcode);
+		if (d == nullptr)
+			return -1;
+
+		//Decoders may grow their buffers as they go
+		size_t before = d->Bytes();
+		int samples = d->Decode(payload, len, pcm, maxSamples);
+		totalBytes.fetch_add(d->Bytes() - before, std::memory_order_relaxed);
+		return samples;
+	}
+
+	void FormatDecoders::Reset() {
+		for (IFormatDecoder* d : decoders) {
+			if (d) d->Reset();
+		}
+	}
+
+	void FormatDecoders::SetSampleRate(int newStreamRate, int newOutRate) {
+		streamRate = newStreamRate;
+		outRate = newOutRate;
+		for (IFormatDecoder* d : decoders) {
+			if (d == nullptr) continue;
+
+			size_t before = d->Bytes();
+			d->SetSampleRate(streamRate, outRate);
+			totalBytes.fetch_add(d->Bytes() - before, std::memory_order_relaxed);
+		}
+	}
+
+	void FormatDecoders::Clear() {
+		for (IFormatDecoder*& d : decoders) {
+			if (d == nullptr) continue;
+
+			totalBytes.fetch_sub(d->Bytes(), std::memory_order_relaxed);
+			delete d;
+			d = nullptr;
+		}
+	}
+}
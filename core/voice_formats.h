@@ -0,0 +1,63 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include "voice_packet.h"
+
+//Decoders for the codec opcodes other than OP_CODEC_OPUSPLC, looked up by opcode.
+//Everything decodes to 16-bit mono PCM, so the rest of the pipeline never sees the format.
+namespace SteamVoice {
+	//Decodes one format's payloads for one player's stream, so it can keep decoder state between packets
+	class IFormatDecoder {
+	public:
+		virtual ~IFormatDecoder() {}
+		//Outputs samples written to pcm or -1 on bad data
+		virtual int Decode(const char* payload, int len, int16_t* pcm, int maxSamples) = 0;
+		virtual void Reset() {}
+		//streamRate is what the packets announce, outRate what Decode outputs at. Outputs false if the format can't do that.
+		virtual bool SetSampleRate(int streamRate, int outRate) { return streamRate == outRate; }
+		//Heap the decoder holds, for the memory stats
+		virtual size_t Bytes() const { return 0; }
+	};
+
+	typedef IFormatDecoder* (*FormatDecoderFactory)();
+
+	struct VoiceFormat {
+		const char* name;
+		FormatDecoderFactory create;
+	};
+
+	//nullptr when nothing can decode the opcode
+	const VoiceFormat* FindFormat(int opcode);
+	//Adds or replaces the decoder for an opcode. Not thread safe, register before any packets flow.
+	void RegisterFormat(int opcode, const char* name, FormatDecoderFactory create);
+
+	//A stream's decoders, created the first time the player sends that format
+	class FormatDecoders {
+	public:
+		FormatDecoders() = default;
+		FormatDecoders(const FormatDecoders&) = delete;
+		FormatDecoders& operator=(const FormatDecoders&) = delete;
+		~FormatDecoders();
+
+		//nullptr if the format isn't supported
+		IFormatDecoder* Get(int opcode);
+		//Decodes with the opcode's decoder, keeping TotalBytes up to date. Outputs samples, or -1 if unsupported or on bad data.
+		int Decode(int opcode, const char* payload, int len, int16_t* pcm, int maxSamples);
+		void Reset();
+		//Applies to the decoders there are and any created later
+		void SetSampleRate(int streamRate, int outRate);
+		//Frees every decoder, Get creates them again when the format shows up next
+		void Clear();
+
+		//Bytes held by every stream's decoders in the process
+		static size_t TotalBytes() { return totalBytes.load(std::memory_order_relaxed); }
+
+	private:
+		IFormatDecoder* decoders[OP_MAX] = {};
+		int streamRate = 24000;
+		int outRate = 24000;
+
+		static inline std::atomic<size_t> totalBytes{0};
+	};
+}
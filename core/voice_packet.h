@@ -0,0 +1,335 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include "crc32.h"
+
+//Non-owning views over steam voice packets. Nothing here allocates or decodes, every read is bounds checked.
+//Packet layout: steamid(8), opcodes, crc32(4). OP_CODEC_OPUSPLC payloads hold [len][seq][opus] frames.
+namespace SteamVoice {
+	//See templates/steam_voice.bt
+	enum {
+		OP_SILENCE = 0,
+		OP_CODEC_LEGACY = 1,
+		OP_CODEC_UNK = 2,
+		OP_CODEC_RAW = 3,
+		OP_CODEC_SILK = 4,
+		OP_CODEC_OPUS = 5,
+		OP_CODEC_OPUSPLC = 6,
+		OP_UNK = 10,
+		OP_SAMPLERATE = 11,
+		OP_MAX = 12
+	};
+
+	//Opcodes whose payload is audio in some format
+	inline bool IsCodecOp(int opcode) {
+		return opcode == OP_CODEC_LEGACY || opcode == OP_CODEC_RAW || opcode == OP_CODEC_SILK || opcode == OP_CODEC_OPUS || opcode == OP_CODEC_OPUSPLC;
+	}
+
+	//Frame length that marks the end of a stream instead of a frame
+	static const uint16_t OPUS_END_OF_STREAM = 0xFFFF;
+	//Largest Opus packet a single frame can encode to (RFC 6716). Our encoder never writes more per frame.
+	#define OPUS_MAX_FRAME_BYTES 1275
+
+	//Offsets of the packet written for one run of Opus audio:
+	//steamid, OP_SAMPLERATE + rate, OP_CODEC_OPUSPLC + payload length, payload, crc
+	namespace OpusPacketLayout {
+		constexpr int STEAMID = 0;
+		constexpr int SAMPLERATE_OP = STEAMID + (int)sizeof(uint64_t);
+		constexpr int SAMPLERATE = SAMPLERATE_OP + 1;
+		constexpr int CODEC_OP = SAMPLERATE + (int)sizeof(uint16_t);
+		constexpr int PAYLOAD_LEN = CODEC_OP + 1;
+		constexpr int PAYLOAD = PAYLOAD_LEN + (int)sizeof(uint16_t);
+		constexpr int HEADER_SIZE = PAYLOAD;
+
+		constexpr int CrcOffset(int payloadLen) { return PAYLOAD + payloadLen; }
+		constexpr int PacketSize(int payloadLen) { return CrcOffset(payloadLen) + (int)sizeof(uint32_t); }
+		//Room needed for frames Opus frames, [len][seq] included
+		constexpr int MaxPacketSize(int frames) { return PacketSize(frames * (2 * (int)sizeof(uint16_t) + OPUS_MAX_FRAME_BYTES)); }
+	}
+
+	//The fixed part of that packet, so it can go out in a single store
+#pragma pack(push, 1)
+	struct OpusPacketHeader {
+		uint64_t steamid;
+		uint8_t sampleRateOp;
+		uint16_t sampleRate;
+		uint8_t codecOp;
+		uint16_t payloadLen;
+	};
+#pragma pack(pop)
+	static_assert(sizeof(OpusPacketHeader) == OpusPacketLayout::HEADER_SIZE, "OpusPacketHeader doesn't match the layout");
+	static_assert(offsetof(OpusPacketHeader, sampleRateOp) == OpusPacketLayout::SAMPLERATE_OP, "OpusPacketHeader doesn't match the layout");
+	static_assert(offsetof(OpusPacketHeader, payloadLen) == OpusPacketLayout::PAYLOAD_LEN, "OpusPacketHeader doesn't match the layout");
+
+	//Where the parts of a written packet ended up, as byte offsets from its start
+	struct PacketOffsets {
+		int size = 0;
+		int payload = 0;
+		int payloadLen = 0;
+		int crc = 0;
+	};
+
+	inline uint16_t ReadU16(const char* p) {
+		uint16_t v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	struct OpusFrame {
+		const unsigned char* data;
+		uint16_t len;
+		uint16_t seq;
+
+		//End of stream markers come through as frames with no data
+		bool EndOfStream() const { return data == nullptr; }
+	};
+
+	//Walks the frames of one OP_CODEC_OPUSPLC payload
+	class OpusFrameIterator {
+	public:
+		OpusFrameIterator(const char* payload, uint16_t len) : cur(payload), end(payload + len) {}
+
+		//Outputs false once the payload is used up, or on a malformed frame (see Corrupt)
+		bool Next(OpusFrame& frame) {
+			//A trailing byte too short to be a length is ignored, like the engine does
+			if (cur + sizeof(uint16_t) > end)
+				return false;
+
+			uint16_t len = ReadU16(cur);
+			cur += sizeof(uint16_t);
+			if (len == OPUS_END_OF_STREAM) {
+				frame = OpusFrame{nullptr, 0, 0};
+				return true;
+			}
+
+			if (cur + sizeof(uint16_t) > end)
+				return Fail();
+			uint16_t seq = ReadU16(cur);
+			cur += sizeof(uint16_t);
+
+			if (len == 0 || cur + len > end)
+				return Fail();
+
+			frame = OpusFrame{(const unsigned char*)cur, len, seq};
+			cur += len;
+			return true;
+		}
+
+		bool Corrupt() const { return corrupt; }
+
+	private:
+		bool Fail() {
+			corrupt = true;
+			cur = end;
+			return false;
+		}
+
+		const char* cur;
+		const char* end;
+		bool corrupt = false;
+	};
+
+	struct VoiceOp {
+		uint8_t opcode;
+		//Samples for OP_SILENCE, the rate for OP_SAMPLERATE, payload bytes for codec opcodes
+		uint16_t value;
+		//Codec opcodes only
+		const char* payload;
+
+		OpusFrameIterator Frames() const { return OpusFrameIterator(payload, value); }
+	};
+
+	//Walks the opcodes of a whole packet
+	class VoicePacketView {
+	public:
+		VoicePacketView(const char* data, int len) : data(data), len(len) {
+			Rewind();
+		}
+
+		//Big enough to hold the steamid and crc. Nothing else is readable otherwise.
+		bool Valid() const { return len >= (int)(sizeof(uint64_t) + sizeof(uint32_t)); }
+
+		uint64_t SteamID() const {
+			uint64_t v;
+			memcpy(&v, data, sizeof(v));
+			return v;
+		}
+
+		uint32_t StoredCRC() const {
+			uint32_t v;
+			memcpy(&v, data + len - sizeof(v), sizeof(v));
+			return v;
+		}
+
+		//Everything the crc covers
+		const char* Data() const { return data; }
+		int CRCCoveredLen() const { return len - (int)sizeof(uint32_t); }
+
+		bool CRCMatches() const {
+			return Valid() && CRC32::ProcessSingleBuffer(data, CRCCoveredLen()) == StoredCRC();
+		}
+
+		//Outputs false at the end of the packet, or on an unknown or truncated opcode (see Corrupt)
+		bool Next(VoiceOp& op) {
+			if (cur >= end)
+				return false;
+
+			uint8_t opcode = (uint8_t)*cur;
+			cur += sizeof(char);
+
+			switch (opcode) {
+			case OP_SILENCE:
+			case OP_SAMPLERATE:
+			case OP_UNK:
+			case OP_CODEC_LEGACY:
+			case OP_CODEC_SILK:
+			case OP_CODEC_OPUS:
+			case OP_CODEC_OPUSPLC: {
+				if (cur + sizeof(uint16_t) > end)
+					return Fail();
+
+				uint16_t value = ReadU16(cur);
+				cur += sizeof(uint16_t);
+
+				const char* payload = nullptr;
+				if (IsCodecOp(opcode)) {
+					if (cur + value > end)
+						return Fail();
+
+					payload = cur;
+					cur += value;
+				}
+
+				op = VoiceOp{opcode, value, payload};
+				return true;
+			}
+			case OP_CODEC_RAW: {
+				//Samples run up to the crc, there's no length
+				if (end - cur > UINT16_MAX)
+					return Fail();
+
+				op = VoiceOp{opcode, (uint16_t)(end - cur), cur};
+				cur = end;
+				return true;
+			}
+			case OP_CODEC_UNK:
+				op = VoiceOp{opcode, 0, nullptr};
+				return true;
+			default:
+				return Fail();
+			}
+		}
+
+		bool Corrupt() const { return corrupt; }
+
+		void Rewind() {
+			corrupt = !Valid();
+			cur = corrupt ? data : data + sizeof(uint64_t);
+			end = corrupt ? data : data + len - sizeof(uint32_t);
+		}
+
+		//Calls fn(const OpusFrame&) for every Opus frame in the packet, skipping end of stream markers.
+		//Outputs the number of frames or -1 on corruption.
+		template <typename Fn>
+		int ForEachOpusFrame(Fn&& fn) {
+			int frames = 0;
+			VoiceOp op;
+			while (Next(op)) {
+				if (op.opcode != OP_CODEC_OPUSPLC)
+					continue;
+
+				OpusFrameIterator it = op.Frames();
+				OpusFrame frame;
+				while (it.Next(frame)) {
+					if (frame.EndOfStream())
+						continue;
+
+					fn(frame);
+					frames++;
+				}
+				if (it.Corrupt())
+					return -1;
+			}
+			return Corrupt() ? -1 : frames;
+		}
+
+	private:
+		bool Fail() {
+			corrupt = true;
+			cur = end;
+			return false;
+		}
+
+		const char* data;
+		int len;
+		const char* cur;
+		const char* end;
+		bool corrupt;
+	};
+
+	//Builds a packet front to back in a caller owned buffer. Any write that doesn't fit makes Finish fail.
+	class VoicePacketWriter {
+	public:
+		VoicePacketWriter(char* out, int maxLen) : base(out), cur(out), end(out + maxLen) {}
+
+		void WriteSteamID(uint64_t steamid) {
+			Put(&steamid, sizeof(steamid));
+		}
+
+		//OP_SILENCE or OP_SAMPLERATE
+		void WriteOp(uint8_t opcode, uint16_t value) {
+			Put(&opcode, sizeof(opcode));
+			Put(&value, sizeof(value));
+		}
+
+		//Reserves an OP_CODEC_OPUSPLC header. The payload goes at the returned pointer, up to space bytes, then EndOpusPayload.
+		char* BeginOpusPayload(int& space) {
+			uint8_t opcode = OP_CODEC_OPUSPLC;
+			uint16_t placeholder = 0;
+			Put(&opcode, sizeof(opcode));
+			Put(&placeholder, sizeof(placeholder));
+			payloadLenAt = cur - sizeof(uint16_t);
+			space = failed ? 0 : (int)(end - cur);
+			return cur;
+		}
+
+		//An empty payload takes its opcode back out
+		void EndOpusPayload(int bytes) {
+			if (failed || bytes < 0 || bytes > end - cur || bytes > UINT16_MAX) {
+				failed = true;
+				return;
+			}
+			if (bytes == 0) {
+				cur = payloadLenAt - sizeof(uint8_t);
+				return;
+			}
+			uint16_t len = (uint16_t)bytes;
+			memcpy(payloadLenAt, &len, sizeof(len));
+			cur += bytes;
+		}
+
+		//Appends the crc. Outputs the packet length or -1 if anything didn't fit.
+		int Finish() {
+			CRC32::CRC32_t crc = CRC32::ProcessSingleBuffer(base, cur - base);
+			Put(&crc, sizeof(crc));
+			return failed ? -1 : (int)(cur - base);
+		}
+
+	private:
+		void Put(const void* v, size_t n) {
+			if (failed || cur + n > end) {
+				failed = true;
+				return;
+			}
+			memcpy(cur, v, n);
+			cur += n;
+		}
+
+		char* base;
+		char* cur;
+		char* end;
+		char* payloadLenAt = nullptr;
+		bool failed = false;
+	};
+}
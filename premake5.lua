@@ -4,11 +4,20 @@ newoption({
 	value = "path to garrysmod_common directory"
 })
 
+newoption({
+	trigger = "disable-timings",
+	description = "Compiles out the voice hook stage timings (transcript.GetTimings)"
+})
+
 local gmcommon = assert(_OPTIONS.gmcommon or os.getenv("GARRYSMOD_COMMON"),
 	"you didn't provide a path to your garrysmod_common (https://github.com/danielga/garrysmod_common) directory")
 include(gmcommon .. "/generator.v3.lua")
 
 CreateWorkspace({name = "transcript"})
+	if _OPTIONS["disable-timings"] then
+		defines("TRANSCRIPT_NO_TIMINGS")
+	end
+
 	CreateProject({serverside = true})
 		IncludeSDKCommon()
 		IncludeSDKTier0()
@@ -18,9 +27,38 @@ CreateWorkspace({name = "transcript"})
 		IncludeLuaShared()
 		IncludeHelpersExtended()
 
-		links("opus")
+		links({"transcript_core", "opus"})
+		includedirs({"core", "opus/include"})
+
+		filter({"platforms:x86_64"})
+			libdirs {"opus/lib64"}
+
+		filter({"platforms:x86"})
+			libdirs {"opus/lib32"}
+
+		filter("system:windows")
+			links("ws2_32")
+
+		filter({})
+
+	-- Codec, packet, effects, recorder and networking code with no GMod SDK dependency
+	project("transcript_core")
+		kind("StaticLib")
+		language("C++")
+		cppdialect("C++17")
+		pic("On")
+		files({"core/*.h", "core/*.cpp"})
 		includedirs("opus/include")
 
+	-- Microbenchmarks for transcript_core. Usage: transcript_bench [--filter name] [--opuspkt file] [--min-time ms] [--list]
+	project("transcript_bench")
+		kind("ConsoleApp")
+		language("C++")
+		cppdialect("C++17")
+		files({"bench/*.h", "bench/*.cpp"})
+		includedirs({"core", "opus/include"})
+		links({"transcript_core", "opus"})
+
 		filter({"platforms:x86_64"})
 			libdirs {"opus/lib64"}
 
@@ -29,3 +67,8 @@ CreateWorkspace({name = "transcript"})
 
 		filter("system:windows")
 			links("ws2_32")
+
+		filter("system:linux")
+			links("pthread")
+
+		filter({})
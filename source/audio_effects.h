@@ -1,38 +0,0 @@
-#pragma once
-#include <cassert>
-#include <cstdint>
-#include <cstring>
-
-namespace AudioEffects {
-	enum {
-		EFF_NONE,
-		EFF_BITCRUSH,
-		EFF_DESAMPLE
-	};
-
-	void BitCrush(uint16_t* sampleBuffer, int samples, float quant, float gainFactor) {
-		for (int i = 0; i < samples; i++) {
-			//Signed shorts range from -32768 to 32767
-			//Let's quantize that a bit
-			float f = (float)sampleBuffer[i];
-			f /= quant;
-			sampleBuffer[i] = (uint16_t)f;
-			sampleBuffer[i] *= quant;
-			sampleBuffer[i] *= gainFactor;
-		}
-	}
-
-	static uint16_t tempBuf[10 * 1024];
-	void Desample(uint16_t* inBuffer, int& samples, int desampleRate = 2) {
-		assert(samples / desampleRate + 1 <= sizeof(tempBuf));
-		int outIdx = 0;
-		for (int i = 0; i < samples; i++) {
-			if (i % desampleRate == 0) continue;
-
-			tempBuf[outIdx] = inBuffer[i];
-			outIdx++;
-		}
-		std::memcpy(inBuffer, tempBuf, outIdx * 2);
-		samples = outIdx;
-	}
-}
\ No newline at end of file
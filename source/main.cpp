@@ -4,22 +4,29 @@
 #include <GarrysMod/FactoryLoader.hpp>
 #include <scanning/symbolfinder.hpp>
 #include <detouring/hook.hpp>
-#include <iostream>
 #include <iclient.h>
-#include <unordered_map>
 #include <chrono>
 #include "ivoicecodec.h"
 #include "audio_effects.h"
 #include "net.h"
 #include "thirdparty.h"
 #include "steam_voice.h"
+#include "crc32.h"
+#include <checksum_crc.h>
 #include "transcript_state.h"
 #include "recorder.h"
 #include <GarrysMod/Symbol.hpp>
 #include <cstdint>
+#include <cstring>
 #include "opus_framedecoder.h"
-
-#define STEAM_PCKT_SZ sizeof(uint64_t) + sizeof(CRC32_t)
+#include "voice_pipeline.h"
+#include "timings.h"
+#include "logger.h"
+#include "scratch_arena.h"
+#include "voice_capture.h"
+#include "sample_convert.h"
+
+#define STEAM_PCKT_SZ sizeof(uint64_t) + sizeof(CRC32::CRC32_t)
 #ifdef SYSTEM_WINDOWS
 	#include <windows.h>
 
@@ -42,36 +49,452 @@
 	};
 #endif
 
-static char decompressedBuffer[20 * 1024];
-static char recompressBuffer[20 * 1024];
+//Scratch space carved out of the processing thread's arena for each packet. PCM is in samples, of whichever type the pipeline uses.
+#define PCM_SCRATCH_SAMPLES (10 * 1024)
+#define PACKET_SCRATCH_SZ (20 * 1024)
 
 Net* net_handl = nullptr;
 transcriptState* g_transcript = nullptr;
+VoicePipeline* g_pipeline = nullptr;
 
 typedef void (*SV_BroadcastVoiceData)(IClient* cl, int nBytes, char* data, int64 xuid);
 Detouring::Hook detour_BroadcastVoiceData;
 
+//Sends the packet through the original SV_BroadcastVoiceData.
+static void CallTrampoline(IClient* cl, int nBytes, char* data, int64 xuid) {
+	TIME_STAGE(STAGE_TRAMPOLINE);
+	detour_BroadcastVoiceData.GetTrampoline<SV_BroadcastVoiceData>()(cl, nBytes, data, xuid);
+}
+
+//Hands a decoded packet to the recorder in timeline order
+static void RecordSpans(int uid, const SteamVoice::DecodedVoice& voice, const int16_t* pcm) {
+	for (int i = 0; i < voice.spanCount; i++) {
+		const SteamVoice::VoiceSpan& span = voice.spans[i];
+		if (span.silent) {
+			g_transcript->recorder.SubmitSilence(uid, span.samples, voice.sampleRate);
+		}
+		else {
+			g_transcript->recorder.SubmitPCM(uid, pcm, span.samples, voice.sampleRate);
+			pcm += span.samples;
+		}
+	}
+}
+
+//The recorder takes int16, so the float pipeline converts once here
+static void RecordSpans(int uid, const SteamVoice::DecodedVoice& voice, const float* pcm, ScratchArena& arena) {
+	int16_t* pcm16 = arena.Alloc<int16_t>(voice.pcmSamples);
+	if (pcm16 == nullptr) {
+		return;
+	}
+	SampleConvert::ToInt16(pcm, pcm16, voice.pcmSamples);
+	RecordSpans(uid, voice, pcm16);
+}
+
+static void RecordSpans(int uid, const SteamVoice::DecodedVoice& voice, const int16_t* pcm, ScratchArena& arena) {
+	RecordSpans(uid, voice, pcm);
+}
+
+static void ApplyEffect(int16_t* pcm, int samples, const AudioEffects::EffectParams& params, AudioEffects::EffectState* state) {
+	AudioEffects::Apply(pcm, samples, params, state);
+}
+
+static void ApplyEffect(float* pcm, int samples, const AudioEffects::EffectParams& params, AudioEffects::EffectState* state) {
+	AudioEffects::Apply(pcm, samples, params, state);
+}
+
+//Runs the effect over each run of audio on its own, so it never reaches across a gap.
+//Effects keep the sample count, so the spans still describe the buffer afterwards.
+template <typename Sample>
+static void ApplyEffectSpans(Sample* pcm, const SteamVoice::DecodedVoice& voice, const AudioEffects::EffectParams& params, AudioEffects::EffectState* state) {
+	for (int i = 0; i < voice.spanCount; i++) {
+		const SteamVoice::VoiceSpan& span = voice.spans[i];
+		if (span.silent) {
+			//What comes after the gap follows silence, not the audio before it
+			if (state != nullptr) state->Reset();
+		}
+		else {
+			ApplyEffect(pcm, span.samples, params, state);
+			pcm += span.samples;
+		}
+	}
+}
+
+//Hands the packet's audio to the recorder as close to how it arrived as possible.
+//Opus is written as is, raw PCM gets encoded by the recorder, other formats aren't recorded.
+static void RecordPassthrough(int uid, const char* data, int nBytes, ScratchArena& arena) {
+	SteamVoice::VoicePacketView view(data, nBytes);
+	SteamVoice::VoiceOp op;
+	int sampleRate = SAMPLERATE_GMOD_OPUS;
+	while (view.Next(op)) {
+		switch (op.opcode) {
+		case SteamVoice::OP_SAMPLERATE:
+			sampleRate = op.value;
+			break;
+		case SteamVoice::OP_SILENCE:
+			g_transcript->recorder.SubmitSilence(uid, op.value, sampleRate);
+			break;
+		case SteamVoice::OP_CODEC_OPUSPLC: {
+			SteamVoice::OpusFrameIterator frames = op.Frames();
+			SteamVoice::OpusFrame frame;
+			while (frames.Next(frame)) {
+				if (!frame.EndOfStream()) {
+					g_transcript->recorder.SubmitOpusPacket(uid, frame.data, frame.len);
+				}
+			}
+			break;
+		}
+		case SteamVoice::OP_CODEC_OPUS:
+			g_transcript->recorder.SubmitOpusPacket(uid, (const unsigned char*)op.payload, op.value);
+			break;
+		case SteamVoice::OP_CODEC_RAW: {
+			//The samples aren't necessarily aligned inside the packet
+			int samples = op.value / 2;
+			int16_t* pcm = arena.Alloc<int16_t>(samples);
+			if (pcm != nullptr && samples > 0) {
+				std::memcpy(pcm, op.payload, samples * sizeof(int16_t));
+				g_transcript->recorder.SubmitPCM(uid, pcm, samples, sampleRate);
+			}
+			break;
+		}
+		}
+	}
+}
+
+//Decompresses the packet, applies the effect and recompresses it with the given encoder profile, returned in outBuf.
+//The new packet is encoded into the arena, then copied over data when it fits in the nBytes of the original.
+//Nothing says how big the caller's buffer really is, so it's never written past nBytes.
+//Sample is int16_t, or float for the float pipeline.
+//Outputs bytes written to outBuf, -1 if the original packet should be sent instead, or 0 if there's nothing to send.
+template <typename Sample>
+static int TranscodeVoicePacket(int uid, IVoiceCodec* codec, const AudioEffects::EffectParams& params, const SteamOpus::EncoderProfile& profile, bool record, char* data, int nBytes, ScratchArena& arena, char*& outBuf) {
+	if (nBytes < (int)(STEAM_PCKT_SZ)) {
+		return -1;
+	}
+
+	Sample* pcm = arena.Alloc<Sample>(PCM_SCRATCH_SAMPLES);
+	if (pcm == nullptr) {
+		return -1;
+	}
+	const int pcmLen = PCM_SCRATCH_SAMPLES;
+	uint64_t steamid = SteamVoice::VoicePacketView(data, nBytes).SteamID();
+
+	//Silence stays a span length from here on, only the recorder turns it into audio
+	SteamVoice::DecodedVoice voice;
+	int samples;
+	{
+		TIME_STAGE(STAGE_DECOMPRESS);
+		samples = SteamVoice::DecodeSpans(codec, data, nBytes, pcm, pcmLen, voice);
+	}
+	// Submit raw PCM for background encoding (mono 16-bit), gaps included so the recording keeps its timing.
+	if (record && samples >= 0 && voice.Samples() > 0) {
+		TIME_STAGE(STAGE_RECORD);
+		RecordSpans(uid, voice, pcm, arena);
+	}
+	//Nothing but silence is already as cheap as it gets, send it as is.
+	//No audio at all means the codec held the frames back for a later packet, or they came too late. Nothing to send.
+	if (samples <= 0) {
+		return samples == 0 && voice.Samples() == 0 ? 0 : -1;
+	}
+
+	#ifdef _DEBUG
+		Log::Write(Log::CAT_DEBUG, "Decompressed samples {}, silent {}", samples, voice.silentSamples);
+	#endif
+
+	//Apply audio effect. Only the decoded samples sit in the buffer, silent spans are skipped for free.
+	{
+		TIME_EFFECT(params.effect);
+		ApplyEffectSpans(pcm, voice, params, codec->GetEffectState());
+	}
+
+	//A worst case bound on the encoded size is far bigger than any real packet, so encode first and look at the size after
+	outBuf = arena.Alloc<char>(PACKET_SCRATCH_SZ);
+	if (outBuf == nullptr) {
+		return -1;
+	}
+
+	//Recompress the stream at the rate it came in, with complexity no higher than the governor currently allows
+	SteamVoice::PacketOffsets offsets;
+	int bytesWritten;
+	{
+		TIME_STAGE(STAGE_COMPRESS);
+		codec->SetEncoderProfile(profile.Capped(g_transcript->governor.ComplexityCap()));
+		bytesWritten = SteamVoice::CompressSpans(steamid, codec, voice, pcm, outBuf, PACKET_SCRATCH_SZ, voice.sampleRate, &offsets);
+	}
+	if (bytesWritten <= 0) {
+		return -1;
+	}
+
+	//Everything needed from the incoming packet has been read, so it takes the new one when it fits
+	if (bytesWritten <= nBytes) {
+		std::memcpy(data, outBuf, bytesWritten);
+		outBuf = data;
+	}
+
+	//Hand the frames we just encoded to the recorder
+	if (record) {
+		TIME_STAGE(STAGE_RECORD);
+		auto submit = [uid](const unsigned char* frame, uint16_t len, uint16_t seq) {
+			g_transcript->recorder.SubmitOpusPacket(uid, frame, len);
+		};
+		if (offsets.payloadLen > 0) {
+			SteamVoice::OpusFrameIterator frames(outBuf + offsets.payload, (uint16_t)offsets.payloadLen);
+			SteamVoice::OpusFrame frame;
+			while (frames.Next(frame)) {
+				if (!frame.EndOfStream()) submit(frame.data, frame.len, frame.seq);
+			}
+		}
+		else {
+			SteamVoice::ForEachOpusFrame(outBuf, bytesWritten, submit);
+		}
+	}
+
+	#ifdef _DEBUG
+		Log::Write(Log::CAT_DEBUG, "Retransmitted pckt size: {}", bytesWritten);
+	#endif
+
+	return bytesWritten;
+}
+
+//Runs on the pipeline workers. On success the job's packet is replaced with the transcoded one.
+static void ProcessVoiceJob(VoiceJob& job, ScratchArena& arena) {
+	//The hook's share of the work that moved to the workers
+	CpuGovernor::Scope cpuScope(g_transcript->governor);
+	char* out = nullptr;
+	int bytesWritten = job.floatPipeline
+		? TranscodeVoicePacket<float>(job.uid, job.codec, job.params, job.profile, job.record, job.data.data(), (int)job.data.size(), arena, out)
+		: TranscodeVoicePacket<int16_t>(job.uid, job.codec, job.params, job.profile, job.record, job.data.data(), (int)job.data.size(), arena, out);
+	//A made up packet has nothing to say on its own
+	if (bytesWritten < 0 && job.synthetic) {
+		bytesWritten = 0;
+	}
+	if (bytesWritten > 0) {
+		if (out != job.data.data()) {
+			job.data.assign(out, out + bytesWritten);
+		}
+		else {
+			job.data.resize(bytesWritten);
+		}
+	}
+	else if (bytesWritten == 0) {
+		job.data.clear();
+	}
+}
+
+//Sends the packets the workers finished since the last frame. Runs from the Think hook.
+static void FlushVoicePipeline() {
+	g_pipeline->Drain([](VoiceJob& job) {
+		//The slot may have been handed to someone else while the packet was in flight
+		if (g_transcript->players[job.slot].generation != job.generation) {
+			return;
+		}
+		//Emptied when the codec is holding the audio back, there's nothing to send yet
+		if (job.data.empty()) {
+			return;
+		}
+		CallTrampoline(job.client, (int)job.data.size(), job.data.data(), job.xuid);
+	});
+}
+
+//Hands a codec back to the pool, or to the pipeline if queued packets may still be using it.
+static void ReleaseCodec(IVoiceCodec* codec) {
+	if (g_pipeline != nullptr) {
+		g_pipeline->Retire(codec);
+	}
+	else {
+		codec->Release();
+	}
+}
+
+//Comes out of the pool already reset, so this never creates Opus state on the game thread unless the pool has run dry
+static IVoiceCodec* CreateCodec() {
+	IVoiceCodec* codec = g_transcript->codecs.Acquire();
+	if (codec != nullptr) {
+		codec->Init(5, SAMPLERATE_GMOD_OPUS);
+	}
+	return codec;
+}
+
+//Gives back the codecs of players who've gone quiet for longer than codecIdleTimeout, including those who left.
+//Reads the same packet timestamps the monitor thread uses for speaking timeouts. Game thread only.
+static void ReclaimIdleCodecs() {
+	using Clock = std::chrono::steady_clock;
+	Clock::time_point now = Clock::now();
+	if (g_transcript->codecIdleTimeout <= Clock::duration::zero() || now - g_transcript->lastIdleSweep < std::chrono::seconds(1)) {
+		return;
+	}
+	g_transcript->lastIdleSweep = now;
+
+	for (auto& p : g_transcript->players) {
+		if (p.codec == nullptr) continue;
+
+		Clock::time_point last(Clock::duration(p.lastPacket.load(std::memory_order_acquire)));
+		if (now - last > g_transcript->codecIdleTimeout) {
+			ReleaseCodec(p.codec);
+			p.codec = nullptr;
+		}
+	}
+}
+
+//Notes where the slot's packets go, for FlushHeldFrames. Only needed while codecs may hold frames back.
+static void TrackHeldRoute(int slot, const PlayerSlot& player, IClient* cl, int64 xuid, const char* data, int nBytes) {
+	if (SteamOpus::Loss::JitterDepth() == 0 || nBytes < (int)(STEAM_PCKT_SZ)) {
+		return;
+	}
+	HeldRoute& route = g_transcript->heldRoutes[slot];
+	route.client = cl;
+	route.xuid = xuid;
+	route.steamid = SteamVoice::VoicePacketView(data, nBytes).SteamID();
+	route.generation = player.generation;
+	route.pending = true;
+}
+
+//Frames a codec holds back for a missing one otherwise only go out with the player's next packet.
+//Once the player has been quiet for longer than a frame may be held, the codec gets a packet without any frames,
+//which releases everything it holds. Runs from the Think hook.
+static void FlushHeldFrames() {
+	using Clock = std::chrono::steady_clock;
+	Clock::time_point now = Clock::now();
+	Clock::duration deadline = std::chrono::milliseconds(20 * SteamOpus::Loss::JitterDepth());
+
+	for (int slot = 0; slot < TRANSCRIPT_MAX_SLOTS; slot++) {
+		HeldRoute& route = g_transcript->heldRoutes[slot];
+		if (!route.pending) continue;
+
+		PlayerSlot& player = g_transcript->players[slot];
+		if (player.generation != route.generation || player.codec == nullptr) {
+			route.pending = false;
+			continue;
+		}
+		Clock::time_point last(Clock::duration(player.lastPacket.load(std::memory_order_acquire)));
+		if (now - last <= deadline) continue;
+		route.pending = false;
+
+		//steamid, an OP_CODEC_OPUSPLC with no frames, crc
+		char packet[sizeof(uint64_t) + 3 + sizeof(CRC32::CRC32_t)];
+		SteamVoice::VoicePacketWriter writer(packet, sizeof(packet));
+		writer.WriteSteamID(route.steamid);
+		writer.WriteOp(SteamVoice::OP_CODEC_OPUSPLC, 0);
+		int len = writer.Finish();
+		if (len < 0) continue;
+
+		bool record = !g_transcript->recordPassthrough;
+		if (g_pipeline != nullptr) {
+			//Behind the player's queued packets, like any other
+			VoiceJob job = g_pipeline->NewJob(packet, len);
+			job.client = route.client;
+			job.uid = player.userid;
+			job.slot = slot;
+			job.generation = player.generation;
+			job.xuid = route.xuid;
+			job.codec = player.codec;
+			job.params = player.params;
+			job.profile = player.profile;
+			job.record = record;
+			job.floatPipeline = g_transcript->floatPipeline;
+			job.synthetic = true;
+			g_pipeline->Submit(std::move(job));
+			continue;
+		}
+
+		ScratchArena& arena = ScratchArena::ForThread();
+		arena.Reset();
+		char* recompressed = nullptr;
+		int bytesWritten = g_transcript->floatPipeline
+			? TranscodeVoicePacket<float>(player.userid, player.codec, player.params, player.profile, record, packet, len, arena, recompressed)
+			: TranscodeVoicePacket<int16_t>(player.userid, player.codec, player.params, player.profile, record, packet, len, arena, recompressed);
+		if (bytesWritten > 0) {
+			CallTrampoline(route.client, bytesWritten, recompressed, route.xuid);
+		}
+	}
+}
+
+//Queues a speaking transition for the monitor thread. Never blocks, drops the event if the monitor has fallen far behind.
+static void PublishSpeakEvent(int type, int slot, int uid, int nBytes) {
+	if (!g_transcript->speakEvents.Push(SpeakEvent{type, slot, uid, nBytes})) {
+		g_transcript->droppedSpeakEvents.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+//Hands the slot to a new userid.
+static void BindSlot(PlayerSlot& player, int slot, int uid) {
+	//Whoever wins the exchange (us or the monitor timing out) reports the STOP
+	if (player.started.exchange(false)) {
+		PublishSpeakEvent(SpeakEvent::STOP, slot, player.userid, 0);
+	}
+
+	player.userid = uid;
+	player.generation++;
+
+	auto pending = g_transcript->pendingEffects.find(uid);
+	int eff = AudioEffects::EFF_NONE;
+	if (pending != g_transcript->pendingEffects.end()) {
+		eff = pending->second;
+		g_transcript->pendingEffects.erase(pending);
+	}
+
+	if (eff == AudioEffects::EFF_NONE) {
+		if (player.codec != nullptr) {
+			ReleaseCodec(player.codec);
+			player.codec = nullptr;
+		}
+	}
+	else if (player.codec == nullptr) {
+		player.codec = CreateCodec();
+	}
+	else {
+		//Don't carry the previous player's stream state over, and keep queued packets off this codec
+		ReleaseCodec(player.codec);
+		player.codec = CreateCodec();
+	}
+	player.params = g_transcript->EffectParamsFor(eff);
+	player.profile = g_transcript->ProfileFor(uid);
+}
+
 void hook_BroadcastVoiceData(IClient* cl, uint nBytes, char* data, int64 xuid) {
+	//The governor's budget covers the whole hook: capture, verification, relay, recording, transcoding and sending
+	CpuGovernor::Scope cpuScope(g_transcript->governor);
+
 	// Basic runtime signature / argument sanity check: if nBytes is unrealistically small or data null, log once.
 	static bool warned_invalid_call = false;
 	if ((data == nullptr || nBytes <= 0) && !warned_invalid_call) {
-		std::cout << "[transcript][warn] SV_BroadcastVoiceData unusual call: data=" << (void*)data << " nBytes=" << nBytes << std::endl;
+		Log::Write(Log::CAT_WARN, "[transcript][warn] SV_BroadcastVoiceData unusual call: data={} nBytes={}", (const void*)data, nBytes);
 		warned_invalid_call = true; // avoid spamming
 	}
 
-	//Check if the player is in the set of enabled players.
-	//This is (and needs to be) and O(1) operation for how often this function is called.
-	//If not in the set, just hit the trampoline to ensure default behavior.
+	//Look up the player's slot state.
+	//This is (and needs to be) a single array access for how often this function is called.
+	//If the slot has no codec, just hit the trampoline to ensure default behavior.
 	int uid = cl->GetUserID();
+	int slot = cl->GetPlayerSlot();
+	if (g_transcript->capture.IsOpen()) {
+		g_transcript->capture.Append(slot, uid, data, nBytes);
+	}
+	if (slot < 0 || slot >= TRANSCRIPT_MAX_SLOTS) {
+		return CallTrampoline(cl, nBytes, data, xuid);
+	}
+	//Clients throw away packets with a bad CRC, so there's no point decoding, relaying or sending them
+	if (g_transcript->verifyCRC) {
+		TIME_STAGE(STAGE_VERIFY);
+		if (!SteamVoice::VoicePacketView(data, nBytes).CRCMatches()) {
+			g_transcript->corruptPackets++;
+			Log::Write(Log::CAT_WARN, "[transcript][warn] Dropped voice packet with bad CRC from userid {} ({} total)", uid, g_transcript->corruptPackets);
+			return;
+		}
+	}
+
+	PlayerSlot& player = g_transcript->players[slot];
+	//Everything this call needs scratch memory for comes from here
+	ScratchArena& arena = ScratchArena::ForThread();
+	arena.Reset();
 
 #ifdef THIRDPARTY_LINK
-	if(checkIfMuted(cl->GetPlayerSlot()+1)) {
-		return detour_BroadcastVoiceData.GetTrampoline<SV_BroadcastVoiceData>()(cl, nBytes, data, xuid);
+	if(checkIfMuted(slot+1)) {
+		return CallTrampoline(cl, nBytes, data, xuid);
 	}
 #endif
 
-	auto& afflicted_players = g_transcript->afflictedPlayers;
 	if (g_transcript->broadcastPackets && nBytes > sizeof(uint64_t)) {
+		TIME_STAGE(STAGE_RELAY);
 		//Get the user's steamid64, put it at the beginning of the buffer.
 		//Notice that we don't use the conveniently provided one in the voice packet. The client can manipulate that one.
 
@@ -81,113 +504,180 @@ void hook_BroadcastVoiceData(IClient* cl, uint nBytes, char* data, int64 xuid) {
 		uint64_t id64 = *(uint64_t*)((char*)cl + 189);
 #endif
 
-		*(uint64_t*)decompressedBuffer = id64;
+		char* relayBuffer = arena.Alloc<char>(nBytes);
+		if (relayBuffer != nullptr) {
+			*(uint64_t*)relayBuffer = id64;
 
-		//Transfer the packet data to our scratch buffer
-		//This looks jank, but it's to prevent a theoretically malformed packet triggering a massive memcpy
-		size_t toCopy = nBytes - sizeof(uint64_t);
-		std::memcpy(decompressedBuffer + sizeof(uint64_t), data + sizeof(uint64_t), toCopy);
+			//Transfer the packet data to our scratch buffer
+			//This looks jank, but it's to prevent a theoretically malformed packet triggering a massive memcpy
+			size_t toCopy = nBytes - sizeof(uint64_t);
+			std::memcpy(relayBuffer + sizeof(uint64_t), data + sizeof(uint64_t), toCopy);
 
-		//Finally we'll broadcast our new packet
- 		net_handl->SendPacket(g_transcript->ip.c_str(), g_transcript->port, decompressedBuffer, nBytes);
+			//Finally we'll broadcast our new packet
+			net_handl->SendPacket(g_transcript->ip.c_str(), g_transcript->port, relayBuffer, nBytes);
+		}
 	}
 
 	// Speaking state tracking using inactivity timeout.
 	// Rationale: once a player stops talking, no further packets arrive, so silence streaks never accumulate.
 	// We'll mark START on first "audio" packet (heuristic: size > header) and mark STOP when no packets seen for timeout.
+	// The monitor thread owns the STOP side and the recorder calls, so this never waits on it.
 	using Clock = std::chrono::steady_clock;
-	static const std::chrono::milliseconds stopTimeout(1200);
 	bool packetHasAudio = nBytes > (int)STEAM_PCKT_SZ; // crude heuristic
-	Clock::time_point now = Clock::now();
 
 	{
-		std::lock_guard<std::mutex> lk(g_transcript->speakMtx);
-		auto &info = g_transcript->speakInfo[uid];
-		info.lastPacket = Clock::now();
-		if (packetHasAudio && !info.started) {
-			info.started = true;
-			g_transcript->currentlySpeaking.insert(uid);
-			std::cout << "[transcript] Player " << uid << " START speaking (" << nBytes << " bytes)" << std::endl;
-			g_transcript->recorder.Start(uid, 24000);
+		TIME_STAGE(STAGE_SPEAKING);
+		if (player.userid != uid) {
+			BindSlot(player, slot, uid);
+		}
+		player.lastPacket.store(Clock::now().time_since_epoch().count(), std::memory_order_release);
+		if (packetHasAudio && !player.started.load(std::memory_order_relaxed) && !player.started.exchange(true)) {
+			PublishSpeakEvent(SpeakEvent::START, slot, uid, nBytes);
 		}
 	}
 
+	//Record-only path: hand the client's Opus frames straight to the recorder, no decode or re-encode
+	if (g_transcript->recordPassthrough && packetHasAudio) {
+		TIME_STAGE(STAGE_RECORD);
+		RecordPassthrough(uid, data, nBytes, arena);
+	}
 
-	if (afflicted_players.find(uid) != afflicted_players.end()) {
-		IVoiceCodec* codec = std::get<0>(afflicted_players.at(uid));
-
-		if(nBytes < STEAM_PCKT_SZ) {
-			return detour_BroadcastVoiceData.GetTrampoline<SV_BroadcastVoiceData>()(cl, nBytes, data, xuid);
+	//The codec was reclaimed while the player was idle, the effect still stands
+	if (player.codec == nullptr && player.params.effect != AudioEffects::EFF_NONE) {
+		player.codec = CreateCodec();
+	}
+	IVoiceCodec* codec = player.codec;
+
+	if (g_pipeline != nullptr) {
+		//Hand the packet to the workers, it gets sent at the start of the next frame.
+		//Packets without an effect only queue up if earlier ones are still in flight, to keep the stream in order.
+		if (codec != nullptr || g_pipeline->HasPending(slot)) {
+			VoiceJob job = g_pipeline->NewJob(data, nBytes);
+			job.client = cl;
+			job.uid = uid;
+			job.slot = slot;
+			job.generation = player.generation;
+			job.xuid = xuid;
+			job.codec = codec;
+			job.params = player.params;
+			job.profile = player.profile;
+			job.record = !g_transcript->recordPassthrough;
+			job.floatPipeline = g_transcript->floatPipeline;
+			if (codec != nullptr) {
+				TrackHeldRoute(slot, player, cl, xuid, data, nBytes);
+			}
+			g_pipeline->Submit(std::move(job));
+			return;
 		}
+		return CallTrampoline(cl, nBytes, data, xuid);
+	}
 
-		int bytesDecompressed = SteamVoice::DecompressIntoBuffer(codec, data, nBytes, decompressedBuffer, sizeof(decompressedBuffer));
-		int samples = bytesDecompressed / 2;
-		// Submit raw PCM for background encoding (mono 16-bit). Decompressed buffer starts with PCM samples.
-		if (samples > 0) {
-			g_transcript->recorder.SubmitPCM(uid, reinterpret_cast<int16_t*>(decompressedBuffer), samples, 24000);
-		}
-		if (bytesDecompressed <= 0) {
+	if (codec != nullptr) {
+		TrackHeldRoute(slot, player, cl, xuid, data, nBytes);
+		char* recompressed = nullptr;
+		bool record = !g_transcript->recordPassthrough;
+		int bytesWritten = g_transcript->floatPipeline
+			? TranscodeVoicePacket<float>(uid, codec, player.params, player.profile, record, data, nBytes, arena, recompressed)
+			: TranscodeVoicePacket<int16_t>(uid, codec, player.params, player.profile, record, data, nBytes, arena, recompressed);
+		if (bytesWritten < 0) {
 			//Just hit the trampoline at this point.
-			return detour_BroadcastVoiceData.GetTrampoline<SV_BroadcastVoiceData>()(cl, nBytes, data, xuid);
+			return CallTrampoline(cl, nBytes, data, xuid);
+		}
+		if (bytesWritten == 0) {
+			//The codec is holding the audio back for later
+			return;
 		}
 
-		#ifdef _DEBUG
-			std::cout << "Decompressed samples " << samples << std::endl;
-		#endif
+		//Broadcast voice data with our updated compressed data.
+		return CallTrampoline(cl, bytesWritten, recompressed, xuid);
+	}
+	else {
+		return CallTrampoline(cl, nBytes, data, xuid);
+	}
+}
 
-		//Apply audio effect
-		int eff = std::get<1>(afflicted_players.at(uid));
-		switch (eff) {
-		case AudioEffects::EFF_BITCRUSH:
-			AudioEffects::BitCrush((uint16_t*)&decompressedBuffer, samples, g_transcript->crushFactor, g_transcript->gainFactor);
-			break;
-		case AudioEffects::EFF_DESAMPLE:
-			AudioEffects::Desample((uint16_t*)&decompressedBuffer, samples, g_transcript->desampleRate);
-			break;
-		default:
-			break;
-		}
+#ifdef TRANSCRIPT_TIMINGS
+static void PushTimingSummary(GarrysMod::Lua::ILuaBase* LUA, const Timings::Summary& summary) {
+	LUA->CreateTable();
+	LUA->PushNumber((double)summary.count);
+	LUA->SetField(-2, "count");
+	LUA->PushNumber(summary.p50us);
+	LUA->SetField(-2, "p50");
+	LUA->PushNumber(summary.p99us);
+	LUA->SetField(-2, "p99");
+	LUA->PushNumber(summary.maxUs);
+	LUA->SetField(-2, "max");
+}
 
-		//Recompress the stream
-		uint64_t steamid = *(uint64_t*)data;
-		int bytesWritten = SteamVoice::CompressIntoBuffer(steamid, codec, decompressedBuffer, samples*2, recompressBuffer, sizeof(recompressBuffer), 24000);
-		if (bytesWritten <= 0) {
-			return detour_BroadcastVoiceData.GetTrampoline<SV_BroadcastVoiceData>()(cl, nBytes, data, xuid);
-		}
-
-		// Submit each contained Opus frame chunk as one packet (our custom container: length+data). Here we only have one contiguous opus payload inside recompressBuffer after headers.
-		// recompressBuffer layout: steamid(8) + OP_SAMPLERATE op + rate(2) + OP_CODEC opcode + len(2) + opusdata + crc(4)
-		if (bytesWritten > (int)(sizeof(uint64_t)+1+2+1+2+4)) {
-			char* ptr = recompressBuffer + sizeof(uint64_t); // after steamid
-			// skip samplerate op (1 +2)
-			ptr += 1 + 2; // OP_SAMPLERATE
-			// opcode OP_CODEC
-			ptr += 1; // opcode
-			uint16_t opusLen = *(uint16_t*)ptr; ptr += 2;
-			if (opusLen > 0 && ptr + opusLen + 4 <= recompressBuffer + bytesWritten) { // +4 for crc at end
-				g_transcript->recorder.SubmitOpusPacket(uid, (unsigned char*)ptr, opusLen);
-			}
-		}
+//Returns { [stage] = { count, p50, p99, max }, effects = { [EFF_*] = {...} } }, times in microseconds
+LUA_FUNCTION_STATIC(transcript_gettimings) {
+	LUA->CreateTable();
+	for (int stage = 0; stage < Timings::STAGE_COUNT; stage++) {
+		PushTimingSummary(LUA, Timings::Summarize((Timings::Stage)stage));
+		LUA->SetField(-2, Timings::StageName((Timings::Stage)stage));
+	}
 
-		#ifdef _DEBUG
-			std::cout << "Retransmitted pckt size: " << bytesWritten << std::endl;
-		#endif
+	LUA->CreateTable();
+	for (int eff : { AudioEffects::EFF_NONE, AudioEffects::EFF_BITCRUSH, AudioEffects::EFF_DESAMPLE }) {
+		LUA->PushNumber(eff);
+		PushTimingSummary(LUA, Timings::SummarizeEffect(eff));
+		LUA->SetTable(-3);
+	}
+	LUA->SetField(-2, "effects");
+	return 1;
+}
 
-		//Broadcast voice data with our updated compressed data.
-		return detour_BroadcastVoiceData.GetTrampoline<SV_BroadcastVoiceData>()(cl, bytesWritten, recompressBuffer, xuid);
+LUA_FUNCTION_STATIC(transcript_resettimings) {
+	Timings::Reset();
+	return 0;
+}
+#endif
+
+//Runs every frame from the Think hook
+LUA_FUNCTION_STATIC(transcript_flush) {
+	{
+		//Sending what the workers finished is hook work moved here, it counts towards the budget too
+		CpuGovernor::Scope cpuScope(g_transcript->governor);
+		if (g_pipeline != nullptr) {
+			FlushVoicePipeline();
+		}
+		FlushHeldFrames();
 	}
-	else {
-		return detour_BroadcastVoiceData.GetTrampoline<SV_BroadcastVoiceData>()(cl, nBytes, data, xuid);
+	g_transcript->governor.Tick();
+	ReclaimIdleCodecs();
+	return 0;
+}
+
+//Stops the workers and sends whatever they still had queued.
+static void StopVoicePipeline() {
+	if (g_pipeline == nullptr) return;
+
+	g_pipeline->Stop();
+	FlushVoicePipeline();
+	delete g_pipeline;
+	g_pipeline = nullptr;
+}
+
+LUA_FUNCTION_STATIC(transcript_async) {
+	bool enable = LUA->GetBool(1);
+	int workers = LUA->IsType(2, GarrysMod::Lua::Type::Number) ? (int)LUA->GetNumber(2) : VoicePipeline::DefaultWorkerCount();
+
+	StopVoicePipeline();
+	if (enable) {
+		g_pipeline = new VoicePipeline(ProcessVoiceJob, workers);
 	}
+	return 0;
 }
 
 LUA_FUNCTION_STATIC(transcript_crush) {
 	g_transcript->crushFactor = (int)LUA->GetNumber(1);
+	g_transcript->ApplyEffectSettings();
 	return 0;
 }
 
 LUA_FUNCTION_STATIC(transcript_gain) {
 	g_transcript->gainFactor = (float)LUA->GetNumber(1);
+	g_transcript->ApplyEffectSettings();
 	return 0;
 }
 
@@ -206,6 +696,47 @@ LUA_FUNCTION_STATIC(transcript_broadcast) {
 	return 0;
 }
 
+LUA_FUNCTION_STATIC(transcript_floatpipeline) {
+	g_transcript->floatPipeline = LUA->GetBool(1);
+	return 0;
+}
+
+LUA_FUNCTION_STATIC(transcript_recordpassthrough) {
+	g_transcript->recordPassthrough = LUA->GetBool(1);
+	return 0;
+}
+
+//Sets the rate new recordings are encoded at, e.g. 16000 for speech recognition or 48000 for archival.
+//Returns false for rates Opus can't encode at.
+LUA_FUNCTION_STATIC(transcript_setrecordingsamplerate) {
+	int rate = (int)LUA->CheckNumber(1);
+	bool valid = rate == 8000 || rate == 12000 || rate == 16000 || rate == 24000 || rate == 48000;
+	if (valid) {
+		g_transcript->recordingSampleRate.store(rate, std::memory_order_relaxed);
+	}
+	LUA->PushBool(valid);
+	return 1;
+}
+
+LUA_FUNCTION_STATIC(transcript_startcapture) {
+	const char* path = LUA->CheckString(1);
+	LUA->PushBool(g_transcript->capture.Open(path));
+	return 1;
+}
+
+//Returns the number of packets captured and dropped
+LUA_FUNCTION_STATIC(transcript_stopcapture) {
+	g_transcript->capture.Close();
+	LUA->PushNumber((double)g_transcript->capture.Captured());
+	LUA->PushNumber((double)g_transcript->capture.Dropped());
+	return 2;
+}
+
+LUA_FUNCTION_STATIC(transcript_verifycrc) {
+	g_transcript->verifyCRC = LUA->GetBool(1);
+	return 0;
+}
+
 LUA_FUNCTION_STATIC(transcript_getcrush) {
 	LUA->PushNumber(g_transcript->crushFactor);
 	return 1;
@@ -213,6 +744,7 @@ LUA_FUNCTION_STATIC(transcript_getcrush) {
 
 LUA_FUNCTION_STATIC(transcript_setdesamplerate) {
 	g_transcript->desampleRate = (int)LUA->GetNumber(1);
+	g_transcript->ApplyEffectSettings();
 	return 0;
 }
 
@@ -220,56 +752,249 @@ LUA_FUNCTION_STATIC(transcript_enableEffect) {
 	int id = LUA->GetNumber(1);
 	int eff = LUA->GetNumber(2);
 
-	auto& afflicted_players = g_transcript->afflictedPlayers;
-	if (afflicted_players.find(id) != afflicted_players.end()) {
+	int slot = g_transcript->FindSlot(id);
+	if (slot == -1) {
+		//Not seen yet, applied once they first speak
 		if (eff == AudioEffects::EFF_NONE) {
-			IVoiceCodec* codec = std::get<0>(afflicted_players.at(id));
-			delete codec;
-			afflicted_players.erase(id);
+			g_transcript->pendingEffects.erase(id);
 		}
 		else {
-			std::get<1>(afflicted_players.at(id)) = eff;
+			g_transcript->pendingEffects[id] = eff;
 		}
 		return 0;
 	}
-	else if(eff != AudioEffects::EFF_NONE) {
 
-		IVoiceCodec* codec = new SteamOpus::Opus_FrameDecoder();
-		codec->Init(5, 24000);
-		afflicted_players.insert(std::pair<int, std::tuple<IVoiceCodec*, int>>(id, std::tuple<IVoiceCodec*, int>(codec, eff)));
+	PlayerSlot& player = g_transcript->players[slot];
+	if (eff == AudioEffects::EFF_NONE) {
+		if (player.codec != nullptr) {
+			ReleaseCodec(player.codec);
+			player.codec = nullptr;
+		}
+	}
+	else if (player.codec == nullptr) {
+		player.codec = CreateCodec();
+	}
+	player.params = g_transcript->EffectParamsFor(eff);
+	return 0;
+}
+
+//Grows the codec pool ahead of time, for servers that expect more players with effects than it starts with
+LUA_FUNCTION_STATIC(transcript_reservecodecs) {
+	g_transcript->codecs.Reserve((int)LUA->CheckNumber(1));
+	LUA->PushNumber(g_transcript->codecs.Capacity());
+	return 1;
+}
+
+//Seconds a player with an effect can go without sending voice before their codec goes back to the pool, 0 to never reclaim
+LUA_FUNCTION_STATIC(transcript_setcodecidletimeout) {
+	double seconds = std::max(LUA->CheckNumber(1), 0.0);
+	g_transcript->codecIdleTimeout = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+	return 0;
+}
+
+//Returns { codecs, codecsInUse, codecCapacity, recorderQueue, recorderTasks, sessions, sessionCount, scratch, total }, sizes in bytes
+LUA_FUNCTION_STATIC(transcript_getmemorystats) {
+	size_t codecs = g_transcript->codecs.Bytes();
+	RecorderMemory recorder = g_transcript->recorder.Memory();
+	size_t scratch = ScratchArena::TotalBytes();
+
+	LUA->CreateTable();
+	LUA->PushNumber((double)codecs);
+	LUA->SetField(-2, "codecs");
+	LUA->PushNumber(g_transcript->codecs.InUse());
+	LUA->SetField(-2, "codecsInUse");
+	LUA->PushNumber(g_transcript->codecs.Capacity());
+	LUA->SetField(-2, "codecCapacity");
+	LUA->PushNumber((double)recorder.queueBytes);
+	LUA->SetField(-2, "recorderQueue");
+	LUA->PushNumber((double)recorder.queuedTasks);
+	LUA->SetField(-2, "recorderTasks");
+	LUA->PushNumber((double)recorder.sessionBytes);
+	LUA->SetField(-2, "sessions");
+	LUA->PushNumber((double)recorder.sessions);
+	LUA->SetField(-2, "sessionCount");
+	LUA->PushNumber((double)scratch);
+	LUA->SetField(-2, "scratch");
+	LUA->PushNumber((double)(codecs + recorder.queueBytes + recorder.sessionBytes + scratch));
+	LUA->SetField(-2, "total");
+	return 1;
+}
+
+LUA_FUNCTION_STATIC(transcript_setmaxconcealframes) {
+	SteamOpus::Loss::SetMaxConcealFrames((int)LUA->GetNumber(1));
+	return 0;
+}
+
+LUA_FUNCTION_STATIC(transcript_setjitterdepth) {
+	SteamOpus::Loss::SetJitterDepth((int)LUA->GetNumber(1));
+	return 0;
+}
+
+//Returns { fec, plc, dropped, late }, counts of lost frames since the module loaded
+LUA_FUNCTION_STATIC(transcript_getlossstats) {
+	SteamOpus::Loss::Counters loss = SteamOpus::Loss::Get();
+	LUA->CreateTable();
+	LUA->PushNumber((double)loss.fec);
+	LUA->SetField(-2, "fec");
+	LUA->PushNumber((double)loss.plc);
+	LUA->SetField(-2, "plc");
+	LUA->PushNumber((double)loss.dropped);
+	LUA->SetField(-2, "dropped");
+	LUA->PushNumber((double)loss.late);
+	LUA->SetField(-2, "late");
+	return 1;
+}
+
+//Overwrites the fields present in the table at index, leaves the rest of profile as it was
+static void ReadEncoderProfile(GarrysMod::Lua::ILuaBase* LUA, int index, SteamOpus::EncoderProfile& profile) {
+	LUA->GetField(index, "complexity");
+	if (LUA->IsType(-1, GarrysMod::Lua::Type::Number)) profile.complexity = (int8_t)LUA->GetNumber(-1);
+	LUA->Pop();
+
+	LUA->GetField(index, "bitrate");
+	if (LUA->IsType(-1, GarrysMod::Lua::Type::Number)) profile.bitrate = (int32_t)LUA->GetNumber(-1);
+	LUA->Pop();
+
+	LUA->GetField(index, "vbr");
+	if (LUA->IsType(-1, GarrysMod::Lua::Type::Bool)) profile.vbr = LUA->GetBool(-1);
+	LUA->Pop();
+
+	LUA->GetField(index, "bandwidth");
+	if (LUA->IsType(-1, GarrysMod::Lua::Type::Number)) profile.maxBandwidth = (int16_t)LUA->GetNumber(-1);
+	LUA->Pop();
+
+	LUA->GetField(index, "application");
+	if (LUA->IsType(-1, GarrysMod::Lua::Type::Number)) profile.application = (int16_t)LUA->GetNumber(-1);
+	LUA->Pop();
+
+	profile = profile.Sanitized();
+}
+
+//SetEncoderProfile(userid, table) changes the given fields of the player's profile, SetEncoderProfile(userid) puts them back on the default
+LUA_FUNCTION_STATIC(transcript_setencoderprofile) {
+	int id = (int)LUA->CheckNumber(1);
+
+	if (LUA->IsType(2, GarrysMod::Lua::Type::Table)) {
+		SteamOpus::EncoderProfile profile = g_transcript->ProfileFor(id);
+		ReadEncoderProfile(LUA, 2, profile);
+		g_transcript->encoderProfiles[id] = profile;
+	}
+	else {
+		g_transcript->encoderProfiles.erase(id);
+	}
+
+	int slot = g_transcript->FindSlot(id);
+	if (slot != -1) {
+		g_transcript->players[slot].profile = g_transcript->ProfileFor(id);
+	}
+	return 0;
+}
+
+//Changes the given fields of the profile used by every player without one of their own
+LUA_FUNCTION_STATIC(transcript_setdefaultencoderprofile) {
+	LUA->CheckType(1, GarrysMod::Lua::Type::Table);
+	ReadEncoderProfile(LUA, 1, g_transcript->defaultProfile);
+
+	for (auto& p : g_transcript->players) {
+		if (p.userid != -1) {
+			p.profile = g_transcript->ProfileFor(p.userid);
+		}
 	}
 	return 0;
 }
 
+LUA_FUNCTION_STATIC(transcript_setcpubudget) {
+	double us = LUA->GetNumber(1);
+	int minComplexity = LUA->IsType(2, GarrysMod::Lua::Type::Number) ? (int)LUA->GetNumber(2) : 0;
+	g_transcript->governor.SetBudget(us, minComplexity);
+	return 0;
+}
+
+//Returns { usPerTick, budget, complexityCap }
+LUA_FUNCTION_STATIC(transcript_getcpustats) {
+	LUA->CreateTable();
+	LUA->PushNumber(g_transcript->governor.UsPerTick());
+	LUA->SetField(-2, "usPerTick");
+	LUA->PushNumber(g_transcript->governor.BudgetUs());
+	LUA->SetField(-2, "budget");
+	LUA->PushNumber(g_transcript->governor.ComplexityCap());
+	LUA->SetField(-2, "complexityCap");
+	return 1;
+}
+
+//Our CRC32 has to match tier1's exactly or clients drop every packet we send.
+//Falls back to the bytewise version, which is tier1's algorithm, if the fast one disagrees.
+static void VerifyCRC32Impl() {
+	unsigned char buf[1024];
+	uint32_t x = 0x12345678;
+	for (auto& b : buf) {
+		x = x * 1664525u + 1013904223u;
+		b = (unsigned char)(x >> 24);
+	}
+
+	for (int len : { 0, 1, 15, 64, 77, 300, 1024 }) {
+		if (CRC32::ProcessSingleBuffer(buf, len) != CRC32_ProcessSingleBuffer(buf, len)) {
+			Log::Write(Log::CAT_WARN, "[transcript][warn] {} CRC32 disagrees with tier1, using bytewise", CRC32::ImplName(CRC32::ActiveImpl()));
+			CRC32::SetImpl(CRC32::IMPL_BYTEWISE);
+			return;
+		}
+	}
+}
 
 GMOD_MODULE_OPEN()
 {
+#ifdef TRANSCRIPT_TIMINGS
+	Timings::Init();
+#endif
+	Log::Start();
+	VerifyCRC32Impl();
 	g_transcript = new transcriptState();
 	// Launch monitor thread for speaking timeout detection
 	g_transcript->monitorThread = std::thread([](){
 		using Clock = std::chrono::steady_clock;
+		const auto pollInterval = std::chrono::milliseconds(20);
 		const auto sweepInterval = std::chrono::milliseconds(300);
 		const auto stopTimeout = std::chrono::milliseconds(1200);
+		//Userid each slot's START was reported for, only touched by this thread
+		int speakingUid[TRANSCRIPT_MAX_SLOTS];
+		std::fill(std::begin(speakingUid), std::end(speakingUid), -1);
+		Clock::time_point lastSweep = Clock::now();
 		while (g_transcript->monitorRunning) {
-			std::this_thread::sleep_for(sweepInterval);
-			Clock::time_point now = Clock::now();
-			std::vector<int> toStop;
-			{
-				std::lock_guard<std::mutex> lk(g_transcript->speakMtx);
-				for (auto &p : g_transcript->speakInfo) {
-					if (p.second.started && (now - p.second.lastPacket) > stopTimeout) {
-						toStop.push_back(p.first);
+			std::this_thread::sleep_for(pollInterval);
+
+			//Handle transitions from the game thread first, so a START is never swept before it's been seen
+			SpeakEvent ev;
+			while (g_transcript->speakEvents.Pop(ev)) {
+				if (ev.type == SpeakEvent::START) {
+					//The slot's last STOP was dropped, don't leave that recording open forever
+					if (speakingUid[ev.slot] != -1 && speakingUid[ev.slot] != ev.userid) {
+						g_transcript->recorder.Stop(speakingUid[ev.slot]);
 					}
+					speakingUid[ev.slot] = ev.userid;
+					Log::Write(Log::CAT_SPEAKING, "[transcript] Player {} START speaking ({} bytes)", ev.userid, ev.nBytes);
+					g_transcript->recorder.Start(ev.userid, g_transcript->recordingSampleRate.load(std::memory_order_relaxed));
 				}
-				for (int sid : toStop) {
-					auto it = g_transcript->speakInfo.find(sid);
-					if (it != g_transcript->speakInfo.end()) {
-						it->second.started = false;
-					}
-					if (g_transcript->currentlySpeaking.find(sid) != g_transcript->currentlySpeaking.end()) {
-						std::cout << "[transcript] Player " << sid << " STOP speaking (timeout)" << std::endl;
-						g_transcript->currentlySpeaking.erase(sid);
-						g_transcript->recorder.Stop(sid);
+				else {
+					Log::Write(Log::CAT_SPEAKING, "[transcript] Player {} STOP speaking (slot reused)", ev.userid);
+					g_transcript->recorder.Stop(ev.userid);
+				}
+			}
+
+			Clock::time_point now = Clock::now();
+			if (now - lastSweep < sweepInterval) continue;
+			lastSweep = now;
+
+			for (int slot = 0; slot < TRANSCRIPT_MAX_SLOTS; slot++) {
+				PlayerSlot& p = g_transcript->players[slot];
+				if (!p.started.load(std::memory_order_acquire)) continue;
+
+				Clock::time_point last(Clock::duration(p.lastPacket.load(std::memory_order_acquire)));
+				if ((now - last) > stopTimeout) {
+					//Lose the race to a fresh packet or a rebind rather than stopping twice
+					bool expected = true;
+					if (p.started.compare_exchange_strong(expected, false)) {
+						Log::Write(Log::CAT_SPEAKING, "[transcript] Player {} STOP speaking (timeout)", speakingUid[slot]);
+						g_transcript->recorder.Stop(speakingUid[slot]);
 					}
 				}
 			}
@@ -331,6 +1056,84 @@ GMOD_MODULE_OPEN()
 		LUA->PushCFunction(transcript_setbroadcastport);
 		LUA->SetTable(-3);
 
+		LUA->PushString("EnablePassthroughRecording");
+		LUA->PushCFunction(transcript_recordpassthrough);
+		LUA->SetTable(-3);
+
+		LUA->PushString("EnableFloatPipeline");
+		LUA->PushCFunction(transcript_floatpipeline);
+		LUA->SetTable(-3);
+
+		LUA->PushString("EnableAsync");
+		LUA->PushCFunction(transcript_async);
+		LUA->SetTable(-3);
+
+		LUA->PushString("EnableCRCCheck");
+		LUA->PushCFunction(transcript_verifycrc);
+		LUA->SetTable(-3);
+
+		LUA->PushString("SetRecordingSampleRate");
+		LUA->PushCFunction(transcript_setrecordingsamplerate);
+		LUA->SetTable(-3);
+
+		LUA->PushString("StartCapture");
+		LUA->PushCFunction(transcript_startcapture);
+		LUA->SetTable(-3);
+
+		LUA->PushString("StopCapture");
+		LUA->PushCFunction(transcript_stopcapture);
+		LUA->SetTable(-3);
+
+		LUA->PushString("SetEncoderProfile");
+		LUA->PushCFunction(transcript_setencoderprofile);
+		LUA->SetTable(-3);
+
+		LUA->PushString("SetDefaultEncoderProfile");
+		LUA->PushCFunction(transcript_setdefaultencoderprofile);
+		LUA->SetTable(-3);
+
+		LUA->PushString("SetCPUBudget");
+		LUA->PushCFunction(transcript_setcpubudget);
+		LUA->SetTable(-3);
+
+		LUA->PushString("GetCPUStats");
+		LUA->PushCFunction(transcript_getcpustats);
+		LUA->SetTable(-3);
+
+		LUA->PushString("ReserveCodecs");
+		LUA->PushCFunction(transcript_reservecodecs);
+		LUA->SetTable(-3);
+
+		LUA->PushString("SetCodecIdleTimeout");
+		LUA->PushCFunction(transcript_setcodecidletimeout);
+		LUA->SetTable(-3);
+
+		LUA->PushString("GetMemoryStats");
+		LUA->PushCFunction(transcript_getmemorystats);
+		LUA->SetTable(-3);
+
+		LUA->PushString("SetMaxConcealFrames");
+		LUA->PushCFunction(transcript_setmaxconcealframes);
+		LUA->SetTable(-3);
+
+		LUA->PushString("SetJitterDepth");
+		LUA->PushCFunction(transcript_setjitterdepth);
+		LUA->SetTable(-3);
+
+		LUA->PushString("GetLossStats");
+		LUA->PushCFunction(transcript_getlossstats);
+		LUA->SetTable(-3);
+
+#ifdef TRANSCRIPT_TIMINGS
+		LUA->PushString("GetTimings");
+		LUA->PushCFunction(transcript_gettimings);
+		LUA->SetTable(-3);
+
+		LUA->PushString("ResetTimings");
+		LUA->PushCFunction(transcript_resettimings);
+		LUA->SetTable(-3);
+#endif
+
 		LUA->PushString("EFF_NONE");
 		LUA->PushNumber(AudioEffects::EFF_NONE);
 		LUA->SetTable(-3);
@@ -342,8 +1145,50 @@ GMOD_MODULE_OPEN()
 		LUA->PushString("EFF_BITCRUSH");
 		LUA->PushNumber(AudioEffects::EFF_BITCRUSH);
 		LUA->SetTable(-3);
+
+		LUA->PushString("OPUS_APPLICATION_VOIP");
+		LUA->PushNumber(OPUS_APPLICATION_VOIP);
+		LUA->SetTable(-3);
+
+		LUA->PushString("OPUS_APPLICATION_AUDIO");
+		LUA->PushNumber(OPUS_APPLICATION_AUDIO);
+		LUA->SetTable(-3);
+
+		LUA->PushString("OPUS_APPLICATION_LOWDELAY");
+		LUA->PushNumber(OPUS_APPLICATION_RESTRICTED_LOWDELAY);
+		LUA->SetTable(-3);
+
+		LUA->PushString("OPUS_BANDWIDTH_NARROWBAND");
+		LUA->PushNumber(OPUS_BANDWIDTH_NARROWBAND);
+		LUA->SetTable(-3);
+
+		LUA->PushString("OPUS_BANDWIDTH_MEDIUMBAND");
+		LUA->PushNumber(OPUS_BANDWIDTH_MEDIUMBAND);
+		LUA->SetTable(-3);
+
+		LUA->PushString("OPUS_BANDWIDTH_WIDEBAND");
+		LUA->PushNumber(OPUS_BANDWIDTH_WIDEBAND);
+		LUA->SetTable(-3);
+
+		LUA->PushString("OPUS_BANDWIDTH_SUPERWIDEBAND");
+		LUA->PushNumber(OPUS_BANDWIDTH_SUPERWIDEBAND);
+		LUA->SetTable(-3);
+
+		LUA->PushString("OPUS_BANDWIDTH_FULLBAND");
+		LUA->PushNumber(OPUS_BANDWIDTH_FULLBAND);
+		LUA->SetTable(-3);
 	LUA->SetTable(-3);
-	LUA->Pop();
+
+	//Async mode sends the processed packets at the start of every frame, and the CPU governor ticks there
+	LUA->GetField(-1, "hook");
+	if (LUA->IsType(-1, GarrysMod::Lua::Type::Table)) {
+		LUA->GetField(-1, "Add");
+		LUA->PushString("Think");
+		LUA->PushString("transcript_flush");
+		LUA->PushCFunction(transcript_flush);
+		LUA->Call(3, 0);
+	}
+	LUA->Pop(2);
 
 	net_handl = new Net();
 
@@ -358,18 +1203,31 @@ GMOD_MODULE_CLOSE()
 {
 	g_transcript->monitorRunning = false;
 	if (g_transcript->monitorThread.joinable()) g_transcript->monitorThread.join();
+
+	LUA->PushSpecial(GarrysMod::Lua::SPECIAL_GLOB);
+	LUA->GetField(-1, "hook");
+	if (LUA->IsType(-1, GarrysMod::Lua::Type::Table)) {
+		LUA->GetField(-1, "Remove");
+		LUA->PushString("Think");
+		LUA->PushString("transcript_flush");
+		LUA->Call(2, 0);
+	}
+	LUA->Pop(2);
+
+	StopVoicePipeline();
 	detour_BroadcastVoiceData.Disable();
 	detour_BroadcastVoiceData.Destroy();
 
-	for (auto& p : g_transcript->afflictedPlayers) {
-		IVoiceCodec* codec = std::get<0>(p.second);
-		if (codec != nullptr) {
-			delete codec;
+	for (auto& p : g_transcript->players) {
+		if (p.codec != nullptr) {
+			p.codec->Release();
+			p.codec = nullptr;
 		}
 	}
 
 	delete net_handl;
 	delete g_transcript;
+	Log::Stop();
 
 	return 0;
 }
@@ -1,28 +1,126 @@
 #pragma once
 #include <string>
 #include <unordered_map>
-#include <unordered_set>
 #include "recorder.h"
-#include <unordered_map>
-#include <mutex>
+#include "audio_effects.h"
+#include "ivoicecodec.h"
+#include "spsc_queue.h"
+#include "voice_capture.h"
+#include "encoder_profile.h"
+#include "cpu_governor.h"
+#include "codec_pool.h"
+#include <atomic>
 #include <thread>
 #include <chrono>
+#include <cstdint>
+
+#define TRANSCRIPT_MAX_SLOTS 128
+
+class IClient;
+
+//Everything the voice hook needs for one player slot, packed into a single cache line.
+//Indexed by IClient::GetPlayerSlot(). The generation is bumped whenever the slot is handed to another userid.
+struct alignas(64) PlayerSlot {
+	IVoiceCodec* codec = nullptr;
+	AudioEffects::EffectParams params;
+	int userid = -1;
+	uint32_t generation = 0;
+	//steady_clock ticks of the last packet and whether we consider the player speaking.
+	//Written by the game thread, read and cleared by the monitor thread.
+	std::atomic<std::chrono::steady_clock::rep> lastPacket{0};
+	std::atomic<bool> started{false};
+	//Encoder settings for this player's re-encoded stream, before the governor's cap
+	SteamOpus::EncoderProfile profile;
+};
+static_assert(sizeof(PlayerSlot) == 64, "PlayerSlot should fill exactly one cache line");
+
+//Where a slot's last packet through its codec came from, so frames the codec holds back waiting on a missing one
+//can still be sent once the player falls quiet. Game thread only, kept out of PlayerSlot's cache line.
+struct HeldRoute {
+	IClient* client = nullptr;
+	int64_t xuid = 0;
+	uint64_t steamid = 0;
+	uint32_t generation = 0;
+	//Set by every packet the codec decodes while the jitter depth is on, cleared once the codec is told to let go
+	bool pending = false;
+};
+
+//Speaking transitions published by the game thread to the monitor thread
+struct SpeakEvent {
+	enum { START, STOP };
+	int type;
+	int slot;
+	int userid;
+	int nBytes;
+};
 
 struct transcriptState {
 	int crushFactor = 350;
 	float gainFactor = 1.2;
 	bool broadcastPackets = false;
+	//Record every speaker's incoming Opus frames as is, instead of transcoding afflicted players' PCM
+	bool recordPassthrough = false;
+	//Decode, apply effects and encode in float, converting to int16 only for the recorder
+	bool floatPipeline = false;
+	//Drop incoming packets whose CRC doesn't match before doing anything else with them.
+	//Off by default, senders that don't fill the CRC in are passed on like the engine does.
+	bool verifyCRC = false;
+	uint64_t corruptPackets = 0;
 	int desampleRate = 2;
 	uint16_t port = 4000;
 	std::string ip = "127.0.0.1";
-	std::unordered_map<int, std::tuple<IVoiceCodec*, int>> afflictedPlayers;
-	//Tracks which userids we currently consider to be actively sending voice data
-	std::unordered_set<int> currentlySpeaking;
+	PlayerSlot players[TRANSCRIPT_MAX_SLOTS];
+	HeldRoute heldRoutes[TRANSCRIPT_MAX_SLOTS];
+	//Effects requested for userids that haven't been seen in a slot yet, applied when they first speak
+	std::unordered_map<int, int> pendingEffects;
+	//Encoder profiles set for specific userids, everyone else gets defaultProfile
+	std::unordered_map<int, SteamOpus::EncoderProfile> encoderProfiles;
+	SteamOpus::EncoderProfile defaultProfile;
+	CpuGovernor governor;
+	//Codecs for players with an effect, set up when the module opens
+	SteamOpus::CodecPool codecs;
+	//Players with an effect who haven't sent a packet for this long give their codec back to the pool.
+	//They keep the effect and get a fresh codec with their next packet. Zero keeps codecs forever.
+	std::chrono::steady_clock::duration codecIdleTimeout = std::chrono::seconds(10);
+	std::chrono::steady_clock::time_point lastIdleSweep;
 	RecorderManager recorder;
-	// Speaking tracking for async timeout detection
-	struct SpeakInfo { std::chrono::steady_clock::time_point lastPacket; bool started = false; };
-	std::unordered_map<int, SpeakInfo> speakInfo;
-	std::mutex speakMtx;
+	//Rate recordings are encoded at, whatever the speaker sends. Read by the monitor thread when a recording starts.
+	std::atomic<int> recordingSampleRate{24000};
+	//Raw copy of every packet the hook sees, while transcript.StartCapture is active
+	VoiceCaptureWriter capture;
+	// Game thread -> monitor thread. The monitor does the recorder work so the hook never waits on file I/O.
+	SpscQueue<SpeakEvent, 1024> speakEvents;
+	std::atomic<uint32_t> droppedSpeakEvents{0};
 	std::thread monitorThread;
-	bool monitorRunning = true;
+	std::atomic<bool> monitorRunning{true};
+
+	//Linear scan, only used from the Lua API
+	int FindSlot(int userid) const {
+		for (int i = 0; i < TRANSCRIPT_MAX_SLOTS; i++) {
+			if (players[i].userid == userid)
+				return i;
+		}
+		return -1;
+	}
+
+	AudioEffects::EffectParams EffectParamsFor(int effect) const {
+		AudioEffects::EffectParams params;
+		params.effect = effect;
+		params.crushFactor = crushFactor;
+		params.gainFactor = gainFactor;
+		params.desampleRate = desampleRate;
+		return params;
+	}
+
+	SteamOpus::EncoderProfile ProfileFor(int userid) const {
+		auto it = encoderProfiles.find(userid);
+		return it != encoderProfiles.end() ? it->second : defaultProfile;
+	}
+
+	//Pushes the global effect settings into every slot
+	void ApplyEffectSettings() {
+		for (auto& p : players) {
+			p.params = EffectParamsFor(p.params.effect);
+		}
+	}
 };
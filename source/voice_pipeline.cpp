@@ -0,0 +1,96 @@
+#include "voice_pipeline.h"
+#include "ivoicecodec.h"
+#include <algorithm>
+
+VoicePipeline::VoicePipeline(ProcessFn fn, int workerCount) : process(fn) {
+    workerCount = std::max(1, workerCount);
+    for (int i = 0; i < workerCount; i++) {
+        workers.emplace_back(new Worker());
+    }
+    for (auto& w : workers) {
+        Worker* wp = w.get();
+        w->thread = std::thread([this, wp]() { WorkerLoop(*wp); });
+    }
+}
+
+VoicePipeline::~VoicePipeline() {
+    Stop();
+    // Workers finish their queues before exiting, so nothing can reference retired codecs anymore.
+    for (auto& r : retired) {
+        r.codec->Release();
+    }
+}
+
+void VoicePipeline::Stop() {
+    running = false;
+    for (auto& w : workers) {
+        std::lock_guard<std::mutex> lock(w->mtx);
+        w->cv.notify_all();
+    }
+    for (auto& w : workers) {
+        if (w->thread.joinable()) w->thread.join();
+    }
+}
+
+int VoicePipeline::DefaultWorkerCount() {
+    int hw = (int)std::thread::hardware_concurrency();
+    // Leave a core for the game thread
+    return std::min(4, std::max(1, hw - 1));
+}
+
+VoiceJob VoicePipeline::NewJob(const char* data, int nBytes) {
+    VoiceJob job;
+    if (!spareBuffers.empty()) {
+        job.data = std::move(spareBuffers.back());
+        spareBuffers.pop_back();
+    }
+    job.data.assign(data, data + nBytes);
+    return job;
+}
+
+void VoicePipeline::Submit(VoiceJob&& job) {
+    job.seq = nextSeq++;
+    pending[job.slot]++;
+    inFlight++;
+    Worker& w = *workers[job.slot % workers.size()];
+    {
+        std::lock_guard<std::mutex> lock(w.mtx);
+        w.queue.push_back(std::move(job));
+    }
+    w.cv.notify_one();
+}
+
+void VoicePipeline::Retire(IVoiceCodec* codec) {
+    retired.push_back(RetiredCodec{codec, nextSeq, inFlight});
+    FreeRetired();
+}
+
+void VoicePipeline::FreeRetired() {
+    auto it = std::remove_if(retired.begin(), retired.end(), [](const RetiredCodec& r) {
+        if (r.waiting > 0) return false;
+        r.codec->Release();
+        return true;
+    });
+    retired.erase(it, retired.end());
+}
+
+void VoicePipeline::WorkerLoop(Worker& w) {
+    for (;;) {
+        VoiceJob job;
+        {
+            std::unique_lock<std::mutex> lock(w.mtx);
+            w.cv.wait(lock, [&]{ return !running || !w.queue.empty(); });
+            if (w.queue.empty()) break; // only reached once stopped
+            job = std::move(w.queue.front());
+            w.queue.pop_front();
+        }
+
+        if (job.codec != nullptr) {
+            w.arena.Reset();
+            process(job, w.arena);
+        }
+
+        std::lock_guard<std::mutex> lock(completedMtx);
+        completed.push_back(std::move(job));
+    }
+}
@@ -0,0 +1,116 @@
+// Worker pool that moves voice transcoding off the game thread.
+// Packets are routed to a worker by player slot, so each player's stream is processed and handed back in order.
+#pragma once
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include "audio_effects.h"
+#include "encoder_profile.h"
+#include "scratch_arena.h"
+
+class IClient;
+class IVoiceCodec;
+
+#define VOICE_PIPELINE_MAX_SLOTS 256
+
+struct VoiceJob {
+    IClient* client = nullptr;
+    int uid = 0;
+    int slot = 0;
+    uint32_t generation = 0;
+    int64_t xuid = 0;
+    uint64_t seq = 0;
+    // Codec to transcode with. nullptr means the packet is only queued to keep the slot's stream in order.
+    IVoiceCodec* codec = nullptr;
+    AudioEffects::EffectParams params;
+    // The player's encoder profile, the governor's complexity cap is applied when encoding
+    SteamOpus::EncoderProfile profile;
+    // Submit the decoded audio to the recorder. Off when passthrough recording already covers the player.
+    bool record = true;
+    // Decode, apply the effect and encode in float instead of int16
+    bool floatPipeline = false;
+    // Made up by the module to make the codec let go of frames it's holding. Only ever sent transcoded.
+    bool synthetic = false;
+    // Incoming packet. Replaced with the processed packet when transcoding succeeds.
+    std::vector<char> data;
+};
+
+class VoicePipeline {
+public:
+    // Called with the worker's own arena, reset before every job
+    typedef void (*ProcessFn)(VoiceJob& job, ScratchArena& arena);
+
+    VoicePipeline(ProcessFn fn, int workers);
+    ~VoicePipeline();
+
+    // Lets the workers finish their queues and joins them. Drain afterwards to collect the last results.
+    void Stop();
+
+    // Game thread only. Returns a job with a recycled packet buffer holding a copy of data.
+    VoiceJob NewJob(const char* data, int nBytes);
+    void Submit(VoiceJob&& job);
+    // Game thread only. True while the slot has packets that haven't been handed back yet.
+    bool HasPending(int slot) const { return pending[slot] != 0; }
+    // Game thread only. Releases the codec once every job submitted before now has been handed back.
+    void Retire(IVoiceCodec* codec);
+
+    // Game thread only. Hands every finished job to fn, in order per slot.
+    template <typename F>
+    void Drain(F&& fn) {
+        {
+            std::lock_guard<std::mutex> lock(completedMtx);
+            drainBuf.swap(completed);
+        }
+        for (auto& job : drainBuf) {
+            fn(job);
+            pending[job.slot]--;
+            inFlight--;
+            for (auto& r : retired) {
+                if (job.seq < r.seq) r.waiting--;
+            }
+            job.data.clear();
+            spareBuffers.push_back(std::move(job.data));
+        }
+        drainBuf.clear();
+        FreeRetired();
+    }
+
+    static int DefaultWorkerCount();
+
+private:
+    struct Worker {
+        std::thread thread;
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::deque<VoiceJob> queue;
+        ScratchArena arena;
+    };
+
+    void WorkerLoop(Worker& w);
+    void FreeRetired();
+
+    ProcessFn process;
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<bool> running{true};
+
+    std::mutex completedMtx;
+    std::vector<VoiceJob> completed;
+
+    // Game thread only state
+    std::vector<VoiceJob> drainBuf;
+    std::vector<std::vector<char>> spareBuffers;
+    struct RetiredCodec {
+        IVoiceCodec* codec;
+        uint64_t seq;   // jobs numbered below this may still use the codec
+        int waiting;    // how many of those are still in flight
+    };
+    std::vector<RetiredCodec> retired;
+    uint64_t nextSeq = 0;
+    int inFlight = 0;
+    int pending[VOICE_PIPELINE_MAX_SLOTS] = {};
+};